@@ -22,22 +22,229 @@
 #include "apt-utils.h"
 #include "apt-messages.h"
 #include "OpPackageKitProgress.h"
+#include "gstMatcher.h"
 
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/configuration.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include <sstream>
 #include <cstdio>
 
+// The package cache kept open between jobs, guarded by sharedLock
+static GMutex sharedLock;
+static AptCacheFile *sharedCache = 0;
+static std::vector<time_t> sharedStamp;
+static bool sharedValid = false;
+
+// Lets the read-only jobs run in parallel, guarded by jobLock
+static GMutex jobLock;
+static GCond jobCond;
+static guint jobReaders = 0;
+static guint jobWritersWaiting = 0;
+static bool jobWriter = false;
+
+static GMutex gstIndexLock;
+static GMutex revDependsLock;
+static GMutex updatesLock;
+static GMutex changelogLock;
+
+/**
+ * Returns the modification times of the files the package cache is built
+ * from, pk_backend_watch_file() can only watch one of them
+ */
+static std::vector<time_t> sharedCacheStamp()
+{
+    const std::string files[] = {
+        _config->FindFile("Dir::State::status"),
+        _config->FindDir("Dir::State::Lists"),
+        _config->FindFile("Dir::Etc::sourcelist"),
+        _config->FindDir("Dir::Etc::sourceparts"),
+        _config->FindFile("Dir::Etc::preferences"),
+        _config->FindDir("Dir::Etc::preferencesparts")
+    };
+
+    std::vector<time_t> stamp;
+    for (unsigned int i = 0; i < G_N_ELEMENTS(files); ++i) {
+        struct stat buf;
+        if (stat(files[i].c_str(), &buf) == 0) {
+            stamp.push_back(buf.st_mtime);
+        } else {
+            stamp.push_back(0);
+        }
+    }
+    return stamp;
+}
+
 AptCacheFile::AptCacheFile(PkBackendJob *job) :
     m_packageRecords(0),
-    m_job(job)
+    m_gstIndex(0),
+    m_revDepends(0),
+    m_job(job),
+    m_shared(0),
+    m_users(0),
+    m_hasUpdates(false)
 {
 }
 
 AptCacheFile::~AptCacheFile()
 {
+    // Don't free what belongs to the shared cache
+    if (m_shared) {
+        if (Map == m_shared->Map) {
+            Map = 0;
+        }
+        if (Cache == m_shared->Cache) {
+            Cache = 0;
+        }
+        if (Policy == m_shared->Policy) {
+            Policy = 0;
+        }
+        if (SrcList == m_shared->SrcList) {
+            SrcList = 0;
+        }
+        if (DCache == m_shared->DCache) {
+            DCache = 0;
+        }
+    }
+
     Close();
 }
 
+AptCacheFile* AptCacheFile::acquireShared(PkBackendJob *job, bool ownDepCache)
+{
+    AptCacheFile *cache = 0;
+
+    g_mutex_lock(&sharedLock);
+    std::vector<time_t> stamp = sharedCacheStamp();
+    if (sharedCache && (!sharedValid || stamp != sharedStamp)) {
+        g_debug("Package cache changed, opening it again");
+
+        // The jobs still using it will free it
+        if (sharedCache->m_users == 0) {
+            delete sharedCache;
+        }
+        sharedCache = 0;
+    }
+
+    if (sharedCache == 0) {
+        // Only share a cache that doesn't need fixing, otherwise each
+        // job has to run CheckDeps() to report the problems
+        AptCacheFile *shared = new AptCacheFile(job);
+        if (shared->Open(false) &&
+                pkgApplyStatus(*shared->DCache) &&
+                shared->DCache->BrokenCount() == 0) {
+            shared->m_job = 0;
+            sharedCache = shared;
+            sharedStamp = stamp;
+            sharedValid = true;
+        } else {
+            delete shared;
+        }
+    }
+
+    if (sharedCache) {
+        cache = new AptCacheFile(job);
+        cache->m_shared = sharedCache;
+        cache->Map = sharedCache->Map;
+        cache->Cache = sharedCache->Cache;
+        cache->Policy = sharedCache->Policy;
+        cache->SrcList = sharedCache->SrcList;
+        cache->DCache = sharedCache->DCache;
+        sharedCache->m_users++;
+    }
+    g_mutex_unlock(&sharedLock);
+
+    if (cache && ownDepCache && !cache->detachDepCache()) {
+        releaseShared(cache);
+        cache = 0;
+    }
+
+    return cache;
+}
+
+void AptCacheFile::releaseShared(AptCacheFile *cache)
+{
+    AptCacheFile *shared = cache->m_shared;
+    delete cache;
+
+    g_mutex_lock(&sharedLock);
+    shared->m_users--;
+    if (shared != sharedCache && shared->m_users == 0) {
+        delete shared;
+    }
+    g_mutex_unlock(&sharedLock);
+}
+
+void AptCacheFile::invalidateShared()
+{
+    g_mutex_lock(&sharedLock);
+    sharedValid = false;
+    if (sharedCache && sharedCache->m_users == 0) {
+        delete sharedCache;
+        sharedCache = 0;
+    }
+    g_mutex_unlock(&sharedLock);
+}
+
+void AptCacheFile::destroyShared()
+{
+    g_mutex_lock(&sharedLock);
+    if (sharedCache && sharedCache->m_users == 0) {
+        delete sharedCache;
+    }
+    sharedCache = 0;
+    sharedValid = false;
+    g_mutex_unlock(&sharedLock);
+}
+
+bool AptCacheFile::detachDepCache()
+{
+    if (m_shared == 0 || DCache != m_shared->DCache) {
+        return true;
+    }
+
+    OpPackageKitProgress progress(m_job);
+    DCache = new pkgDepCache(Cache, Policy);
+    if (DCache->Init(&progress) == false || pkgApplyStatus(*DCache) == false) {
+        show_errors(m_job, PK_ERROR_ENUM_INTERNAL_ERROR);
+        return false;
+    }
+    return true;
+}
+
+void AptCacheFile::lockJobs(bool exclusive)
+{
+    g_mutex_lock(&jobLock);
+    if (exclusive) {
+        jobWritersWaiting++;
+        while (jobWriter || jobReaders > 0) {
+            g_cond_wait(&jobCond, &jobLock);
+        }
+        jobWritersWaiting--;
+        jobWriter = true;
+    } else {
+        // Don't let a stream of read-only jobs starve a waiting writer
+        while (jobWriter || jobWritersWaiting > 0) {
+            g_cond_wait(&jobCond, &jobLock);
+        }
+        jobReaders++;
+    }
+    g_mutex_unlock(&jobLock);
+}
+
+void AptCacheFile::unlockJobs(bool exclusive)
+{
+    g_mutex_lock(&jobLock);
+    if (exclusive) {
+        jobWriter = false;
+    } else {
+        jobReaders--;
+    }
+    g_cond_broadcast(&jobCond);
+    g_mutex_unlock(&jobLock);
+}
+
 bool AptCacheFile::Open(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
@@ -47,8 +254,12 @@ bool AptCacheFile::Open(bool withLock)
 void AptCacheFile::Close()
 {
     delete m_packageRecords;
+    delete m_gstIndex;
+    delete m_revDepends;
 
     m_packageRecords = 0;
+    m_gstIndex = 0;
+    m_revDepends = 0;
 
     pkgCacheFile::Close();
 
@@ -110,6 +321,131 @@ bool AptCacheFile::CheckDeps(bool AllowBroken)
     return true;
 }
 
+const RevDepends* AptCacheFile::GetRevDepends()
+{
+    // Build the index once for all the jobs using the shared cache
+    if (m_shared) {
+        g_mutex_lock(&revDependsLock);
+        const RevDepends *revDepends = m_shared->GetRevDepends();
+        g_mutex_unlock(&revDependsLock);
+        return revDepends;
+    }
+
+    if (m_revDepends) {
+        return m_revDepends;
+    }
+
+    pkgCache *cache = GetPkgCache();
+    unsigned long count = cache->HeaderP->PackageCount;
+
+    // The versions AptIntf::getDepends() follows
+    std::vector<pkgCache::VerIterator> vers(count);
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        vers[pkg.Index()] = findVer(pkg);
+    }
+
+    // Count the parents first so they can be stored in one array,
+    // a parent depending twice on the same package is stored once
+    std::vector<unsigned long> sizes(count, 0);
+    std::vector<unsigned long> last(count, count);
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            m_revDepends = new RevDepends;
+            m_revDepends->offsets.resize(count + 1, 0);
+            for (unsigned long i = 0; i < count; ++i) {
+                m_revDepends->offsets[i + 1] = m_revDepends->offsets[i] + sizes[i];
+            }
+            m_revDepends->parents.resize(m_revDepends->offsets[count]);
+            std::fill(sizes.begin(), sizes.end(), 0);
+            std::fill(last.begin(), last.end(), count);
+        }
+
+        for (unsigned long parent = 0; parent < count; ++parent) {
+            const pkgCache::VerIterator &ver = vers[parent];
+            if (ver.end()) {
+                continue;
+            }
+
+            for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep) {
+                if (dep->Type != pkgCache::Dep::Depends) {
+                    continue;
+                }
+
+                unsigned long target = dep.TargetPkg().Index();
+                if (vers[target].end() || last[target] == parent) {
+                    continue;
+                }
+                last[target] = parent;
+
+                if (pass == 1) {
+                    m_revDepends->parents[m_revDepends->offsets[target] + sizes[target]] = parent;
+                }
+                sizes[target]++;
+            }
+        }
+    }
+
+    return m_revDepends;
+}
+
+bool AptCacheFile::getUpdates(PkgList &updates, PkgList &blocked)
+{
+    // Only the shared cache lives long enough to be worth it
+    if (m_shared == 0) {
+        return false;
+    }
+
+    g_mutex_lock(&updatesLock);
+    bool ret = m_shared->m_hasUpdates;
+    if (ret) {
+        updates = m_shared->m_updates;
+        blocked = m_shared->m_blocked;
+    }
+    g_mutex_unlock(&updatesLock);
+    return ret;
+}
+
+void AptCacheFile::setUpdates(const PkgList &updates, const PkgList &blocked)
+{
+    if (m_shared == 0) {
+        return;
+    }
+
+    g_mutex_lock(&updatesLock);
+    m_shared->m_updates = updates;
+    m_shared->m_blocked = blocked;
+    m_shared->m_hasUpdates = true;
+    g_mutex_unlock(&updatesLock);
+}
+
+bool AptCacheFile::getChangelog(const pkgCache::VerIterator &ver, ChangelogInfo &info)
+{
+    if (m_shared == 0) {
+        return false;
+    }
+
+    g_mutex_lock(&changelogLock);
+    std::map<unsigned long, ChangelogInfo>::const_iterator it;
+    it = m_shared->m_changelogs.find(ver.Index());
+    bool ret = it != m_shared->m_changelogs.end();
+    if (ret) {
+        info = it->second;
+    }
+    g_mutex_unlock(&changelogLock);
+    return ret;
+}
+
+void AptCacheFile::setChangelog(const pkgCache::VerIterator &ver, const ChangelogInfo &info)
+{
+    if (m_shared == 0) {
+        return;
+    }
+
+    g_mutex_lock(&changelogLock);
+    m_shared->m_changelogs[ver.Index()] = info;
+    g_mutex_unlock(&changelogLock);
+}
+
 bool AptCacheFile::DistUpgrade()
 {
     return pkgDistUpgrade(*this);
@@ -258,6 +594,47 @@ void AptCacheFile::buildPkgRecords()
     m_packageRecords = new pkgRecords(*this);
 }
 
+GstIndex* AptCacheFile::GetGstIndex()
+{
+    // Build the index once for all the jobs using the shared cache
+    if (m_shared) {
+        g_mutex_lock(&gstIndexLock);
+        GstIndex *index = m_shared->GetGstIndex();
+        g_mutex_unlock(&gstIndexLock);
+        return index;
+    }
+
+    if (m_gstIndex) {
+        return m_gstIndex;
+    }
+
+    m_gstIndex = new GstIndex;
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        pkgCache::VerIterator ver = findVer(pkg);
+        if (ver.end() == true) {
+            ver = findCandidateVer(pkg);
+            if (ver.end() == true) {
+                continue;
+            }
+        }
+
+        pkgRecords::Parser &rec = GetPkgRecords()->Lookup(ver.FileList());
+        const char *start, *stop;
+        rec.GetRec(start, stop);
+        string record(start, stop - start);
+        if (record.find("\nGstreamer-Version: ") != string::npos) {
+            m_gstIndex->add(record, pkg.Index());
+        }
+    }
+
+    return m_gstIndex;
+}
+
 bool AptCacheFile::doAutomaticRemove()
 {
     pkgDepCache::ActionGroup group(*this);
@@ -426,7 +803,16 @@ std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
 
 std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
 {
-    if (ver.end() || ver.FileList().end() || GetPkgRecords() == 0) {
+    if (GetPkgRecords() == 0) {
+        return string();
+    }
+    return getLongDescription(ver, *m_packageRecords);
+}
+
+std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver,
+                                             pkgRecords &records)
+{
+    if (ver.end() || ver.FileList().end()) {
         return string();
     }
 
@@ -439,7 +825,7 @@ std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).LongDesc();
+        return records.Lookup(df).LongDesc();
     }
 }
 
@@ -23,13 +23,84 @@
 #include <apt-pkg/cachefile.h>
 #include <pk-backend.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PkgList.h"
+
 class pkgProblemResolver;
+class GstIndex;
+
+/**
+ * The packages whose version depends on the version of each package, the
+ * ones of the package with index i are parents[offsets[i]..offsets[i + 1]]
+ */
+struct RevDepends {
+    std::vector<unsigned long> offsets;
+    std::vector<unsigned long> parents;
+};
+
+/**
+ * The parts of a changelog shown in the update details
+ */
+typedef struct {
+    std::string changelog;
+    std::string updateText;
+    std::string issued;
+    std::string updated;
+    std::vector<std::string> bugzillaUrls;
+    std::vector<std::string> cveUrls;
+} ChangelogInfo;
 class AptCacheFile : public pkgCacheFile
 {
 public:
     AptCacheFile(PkBackendJob *job);
     ~AptCacheFile();
 
+    /**
+      * Returns a package cache for the job using the maps, the policy
+      * and, unless ownDepCache is true, the dependency cache of the cache
+      * kept open between jobs. That cache is opened again if it was
+      * invalidated or the files it was built from changed.
+      * Returns NULL if it can't be opened or needs fixing
+      * @note the cache must be freed with releaseShared()
+      */
+    static AptCacheFile* acquireShared(PkBackendJob *job, bool ownDepCache);
+
+    /**
+      * Frees a cache returned by acquireShared()
+      * @note the shared dependency cache is never marked, so there is
+      * nothing to reset here: whatever marks packages calls
+      * detachDepCache() first and its own dependency cache is freed
+      */
+    static void releaseShared(AptCacheFile *cache);
+
+    /**
+      * Makes the next acquireShared() open the package cache again
+      */
+    static void invalidateShared();
+
+    /**
+      * Frees the shared package cache
+      */
+    static void destroyShared();
+
+    /**
+      * Gives this cache its own dependency cache, so packages can be
+      * marked without changing the one other jobs are reading
+      * @note call it before creating a pkgProblemResolver or an
+      * ActionGroup, they keep a reference to the dependency cache
+      */
+    bool detachDepCache();
+
+    /**
+      * Waits until the job can run, read-only jobs run in parallel while
+      * an exclusive one runs alone
+      */
+    static void lockJobs(bool exclusive);
+    static void unlockJobs(bool exclusive);
+
     /**
       * Inits the package cache returning false if it can't open
       */
@@ -67,6 +138,36 @@ public:
 
     inline pkgRecords* GetPkgRecords() { buildPkgRecords(); return m_packageRecords; }
 
+    /**
+      * GetGstIndex will index the GStreamer fields of the package records
+      * the first time it's needed for this cache
+      */
+    GstIndex* GetGstIndex();
+
+    /**
+      * GetRevDepends will index the reverse dependencies between the
+      * versions returned by findVer() the first time it's needed for
+      * this cache
+      */
+    const RevDepends* GetRevDepends();
+
+    /**
+      * Returns the upgrades and the blocked packages stored by
+      * setUpdates() on the shared cache, which is opened again when the
+      * status, the lists or the pinning change
+      * @returns false if they weren't computed for this cache yet
+      */
+    bool getUpdates(PkgList &updates, PkgList &blocked);
+    void setUpdates(const PkgList &updates, const PkgList &blocked);
+
+    /**
+      * Returns the changelog of the version stored by setChangelog() on
+      * the shared cache, it depends on the installed version too
+      * @returns false if it wasn't parsed for this cache yet
+      */
+    bool getChangelog(const pkgCache::VerIterator &ver, ChangelogInfo &info);
+    void setChangelog(const pkgCache::VerIterator &ver, const ChangelogInfo &info);
+
     /**
       * GetPolicy will build the policy object if needed and return it
       * @note This override if because the cache should be built before the policy
@@ -121,6 +222,12 @@ public:
      */
     std::string getLongDescription(const pkgCache::VerIterator &ver);
 
+    /** \return the long description of the given version read with
+     *  the given parser, so that each thread can use its own.
+     */
+    static std::string getLongDescription(const pkgCache::VerIterator &ver,
+                                          pkgRecords &records);
+
     /** \return a short description string corresponding to the given
      *  version.
      */
@@ -138,7 +245,15 @@ private:
     static std::string debParser(std::string descr);
 
     pkgRecords *m_packageRecords;
+    GstIndex *m_gstIndex;
+    RevDepends *m_revDepends;
     PkBackendJob *m_job;
+    AptCacheFile *m_shared;
+    guint m_users;
+    bool m_hasUpdates;
+    PkgList m_updates;
+    PkgList m_blocked;
+    std::map<unsigned long, ChangelogInfo> m_changelogs;
 };
 
 #endif // APTCACHEFILE_H
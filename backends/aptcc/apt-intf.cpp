@@ -36,8 +36,11 @@
 #include <sys/fcntl.h>
 #include <pty.h>
 
+#include <algorithm>
 #include <fstream>
+#include <map>
 #include <dirent.h>
+#include <locale.h>
 
 #include "AptCacheFile.h"
 #include "apt-utils.h"
@@ -47,15 +50,71 @@
 #include "acqpkitstatus.h"
 #include "pkg_acqfile.h"
 #include "deb-file.h"
+#include "description-index.h"
+#include "dpkg-file-index.h"
+#include "mime-index.h"
 
 #define RAMFS_MAGIC     0x858458f6
 
+/**
+ * job_locale:
+ *
+ * Jobs run in parallel, so each thread sets its own locale instead of
+ * changing the one of the daemon. The locales are kept for the next jobs.
+ */
+static locale_t job_locale(const gchar *name)
+{
+    static GMutex lock;
+    static map<string, locale_t> locales;
+
+    g_mutex_lock(&lock);
+    locale_t loc;
+    map<string, locale_t>::const_iterator it = locales.find(name);
+    if (it != locales.end()) {
+        loc = it->second;
+    } else {
+        loc = newlocale(LC_ALL_MASK, name, (locale_t) 0);
+        if (loc == (locale_t) 0) {
+            g_debug("Failed to load the locale %s", name);
+        }
+        locales[name] = loc;
+    }
+    g_mutex_unlock(&lock);
+    return loc;
+}
+
+AptJobLocale::AptJobLocale(PkBackendJob *job)
+{
+    gchar *locale = pk_backend_job_get_locale(job);
+    if (locale) {
+        locale_t loc = job_locale(locale);
+        if (loc != (locale_t) 0) {
+            uselocale(loc);
+        }
+        // TODO why this cuts characthers on ui?
+        // 		string _locale(locale);
+        // 		size_t found;
+        // 		found = _locale.find('.');
+        // 		_locale.erase(found);
+        // 		_config->Set("APT::Acquire::Translation", _locale);
+    }
+    g_free(locale);
+}
+
+AptJobLocale::~AptJobLocale()
+{
+    uselocale(LC_GLOBAL_LOCALE);
+}
+
 AptIntf::AptIntf(PkBackendJob *job) :
     m_job(job),
     m_cancel(false),
     m_terminalTimeout(120),
     m_lastSubProgress(0),
-    m_cache(0)
+    m_cache(0),
+    m_sharedCache(false),
+    m_exclusive(true),
+    m_locked(false)
 {
     m_cancel = false;
 
@@ -65,42 +124,21 @@ AptIntf::AptIntf(PkBackendJob *job) :
 
 bool AptIntf::init()
 {
-    gchar *locale;
     gchar *http_proxy;
     gchar *ftp_proxy;
 
     m_isMultiArch = APT::Configuration::getArchitectures(false).size() > 1;
 
-    // set locale
-    if (locale = pk_backend_job_get_locale(m_job)) {
-        setlocale(LC_ALL, locale);
-        // TODO why this cuts characthers on ui?
-        // 		string _locale(locale);
-        // 		size_t found;
-        // 		found = _locale.find('.');
-        // 		_locale.erase(found);
-        // 		_config->Set("APT::Acquire::Translation", _locale);
-    }
-    g_free(locale);
-
-    // set http proxy
-    http_proxy = pk_backend_job_get_proxy_http(m_job);
-    setenv("http_proxy", http_proxy, 1);
-    g_free(http_proxy);
-
-    // set ftp proxy
-    ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
-    setenv("ftp_proxy", ftp_proxy, 1);
-    g_free(ftp_proxy);
-
     // Prepare for the restart thing
     if (g_file_test(REBOOT_REQUIRED, G_FILE_TEST_EXISTS)) {
         g_stat(REBOOT_REQUIRED, &m_restartStat);
     }
 
     // Check if we should open the Cache with lock
-    bool withLock;
+    bool withLock = false;
     bool AllowBroken = false;
+    bool shared = true;
+    bool ownDepCache = true;
     PkRoleEnum role = pk_backend_job_get_role(m_job);
     switch (role) {
     case PK_ROLE_ENUM_INSTALL_PACKAGES:
@@ -111,9 +149,31 @@ bool AptIntf::init()
         break;
     case PK_ROLE_ENUM_REPAIR_SYSTEM:
         AllowBroken = true;
+        shared = false;
+        break;
+    case PK_ROLE_ENUM_REFRESH_CACHE:
+        shared = false;
+        break;
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_GET_UPDATES:
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_WHAT_PROVIDES:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+        // These only read the cache, so they can run together and
+        // share its dependency cache, the ones that need to mark
+        // packages detach it first
+        m_exclusive = false;
+        ownDepCache = false;
         break;
     default:
-        withLock = false;
+        break;
     }
 
     bool simulate = false;
@@ -122,28 +182,57 @@ bool AptIntf::init()
         PkBitfield transactionFlags = pk_backend_job_get_transaction_flags(m_job);
         simulate = pk_bitfield_contain(transactionFlags, PK_TRANSACTION_FLAG_ENUM_SIMULATE);
 
-        // Disable the lock if we are simulating
+        // Disable the lock if we are simulating, the marks are done
+        // on a dependency cache of our own
         withLock = !simulate;
+        shared = simulate;
     }
 
-    // Create the AptCacheFile class to search for packages
-    m_cache = new AptCacheFile(m_job);
+    AptCacheFile::lockJobs(m_exclusive);
+    m_locked = true;
 
-    int timeout = 10;
-    // TODO test this
-    while (m_cache->Open(withLock) == false) {
-        if (withLock == false || (timeout <= 0)) {
-            show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
-            return false;
-        } else {
-            _error->Discard();
-            pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
-            sleep(1);
-            timeout--;
+    if (m_exclusive) {
+        // The acquire methods read the proxy from the environment, which
+        // is only safe to change while no other job is running
+        http_proxy = pk_backend_job_get_proxy_http(m_job);
+        setenv("http_proxy", http_proxy, 1);
+        g_free(http_proxy);
+
+        ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
+        setenv("ftp_proxy", ftp_proxy, 1);
+        g_free(ftp_proxy);
+    }
+
+    // Reuse the cache opened by the previous jobs
+    if (shared) {
+        m_cache = AptCacheFile::acquireShared(m_job, ownDepCache);
+        m_sharedCache = m_cache != 0;
+        if (m_sharedCache) {
+            // The shared cache is only kept if it has no broken packages
+            return true;
         }
+    }
+
+    if (m_cache == 0) {
+        // Create the AptCacheFile class to search for packages
+        m_cache = new AptCacheFile(m_job);
+
+        int timeout = 10;
+        // TODO test this
+        while (m_cache->Open(withLock) == false) {
+            if (withLock == false || (timeout <= 0)) {
+                show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+                return false;
+            } else {
+                _error->Discard();
+                pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+                sleep(1);
+                timeout--;
+            }
 
-        // Close the cache if we are going to try again
-        m_cache->Close();
+            // Close the cache if we are going to try again
+            m_cache->Close();
+        }
     }
 
     // Check if there are half-installed packages and if we can fix them
@@ -171,7 +260,19 @@ AptIntf::~AptIntf()
         }
     }
 
-    delete m_cache;
+    if (m_sharedCache) {
+        AptCacheFile::releaseShared(m_cache);
+    } else if (m_cache) {
+        delete m_cache;
+
+        // This job may have changed the system, so don't let the
+        // next jobs see the old package cache
+        AptCacheFile::invalidateShared();
+    }
+
+    if (m_locked) {
+        AptCacheFile::unlockJobs(m_exclusive);
+    }
 }
 
 void AptIntf::cancel()
@@ -339,6 +440,11 @@ PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED) && ret.size() > 0) {
             PkgList downloaded;
 
+            // Marking the packages must not change what other jobs see
+            if (!m_cache->detachDepCache()) {
+                return downloaded;
+            }
+
             pkgProblemResolver Fix(*m_cache);
             {
                 pkgDepCache::ActionGroup group(*m_cache);
@@ -504,22 +610,21 @@ void AptIntf::providesCodec(PkgList &output, gchar **values)
 {
     GstMatcher *matcher = new GstMatcher(values);
     if (!matcher->hasMatches()) {
+        delete matcher;
         return;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+    // Only the packages declaring one of the wanted types need their
+    // records checked
+    pkgCache *cache = m_cache->GetPkgCache();
+    vector<unsigned int> pkgIds = matcher->candidates(*m_cache->GetGstIndex());
+    for (vector<unsigned int>::const_iterator it = pkgIds.begin(); it != pkgIds.end(); ++it) {
         if (m_cancel) {
-            delete matcher;
             break;
         }
 
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
         // TODO search in updates packages
-        // Ignore virtual packages
+        pkgCache::PkgIterator pkg(*cache, cache->PkgP + *it);
         pkgCache::VerIterator ver = m_cache->findVer(pkg);
         if (ver.end() == true) {
             ver = m_cache->findCandidateVer(pkg);
@@ -758,8 +863,137 @@ void AptIntf::emitDetails(PkgList &pkgs)
     }
 }
 
+/**
+ * parse_changelog:
+ *
+ * Collects the changes newer than the installed version
+ */
+static void parse_changelog(const string &filename,
+                            const string &srcpkg,
+                            const pkgCache::VerIterator &currver,
+                            ChangelogInfo &info)
+{
+    ifstream in(filename.c_str());
+    string line;
+    GRegex *regexVer;
+    regexVer = g_regex_new("(?'source'.+) \\((?'version'.*)\\) "
+                           "(?'dist'.+); urgency=(?'urgency'.+)",
+                           G_REGEX_CASELESS,
+                           G_REGEX_MATCH_ANCHORED,
+                           0);
+    GRegex *regexDate;
+    regexDate = g_regex_new("^ -- (?'maintainer'.+) (?'mail'<.+>)  (?'date'.+)$",
+                            G_REGEX_CASELESS,
+                            G_REGEX_MATCH_ANCHORED,
+                            0);
+
+    while (getline(in, line)) {
+        // we don't want the additional whitespace, because it can confuse
+        // some markdown parsers used by client tools
+        if (starts_with(line, "  "))
+            line.erase(0,1);
+        // no need to free str later, it is allocated in a static buffer
+        const char *str = utf8(line.c_str());
+        if (strcmp(str, "") == 0) {
+            info.changelog.append("\n");
+            continue;
+        } else {
+            info.changelog.append(str);
+            info.changelog.append("\n");
+        }
+
+        if (starts_with(str, srcpkg.c_str())) {
+            // Check to see if the the text isn't about the current package,
+            // otherwise add a == version ==
+            GMatchInfo *match_info;
+            if (g_regex_match(regexVer, str, G_REGEX_MATCH_ANCHORED, &match_info)) {
+                gchar *version;
+                version = g_match_info_fetch_named(match_info, "version");
+
+                // Compare if the current version is shown in the changelog, to not
+                // display old changelog information
+                if (_system != 0  &&
+                        _system->VS->DoCmpVersion(version, version + strlen(version),
+                                                  currver.VerStr(), currver.VerStr() + strlen(currver.VerStr())) <= 0) {
+                    g_free (version);
+                    g_match_info_free (match_info);
+                    break;
+                } else {
+                    if (!info.updateText.empty()) {
+                        info.updateText.append("\n\n");
+                    }
+                    info.updateText.append(" == ");
+                    info.updateText.append(version);
+                    info.updateText.append(" ==");
+                    g_free (version);
+                }
+            }
+            g_match_info_free (match_info);
+        } else if (starts_with(str, " ")) {
+            // update descritption
+            info.updateText.append("\n");
+            info.updateText.append(str);
+        } else if (starts_with(str, " --")) {
+            // Parse the text to know when the update was issued,
+            // and when it got updated
+            GMatchInfo *match_info;
+            if (g_regex_match(regexDate, str, G_REGEX_MATCH_ANCHORED, &match_info)) {
+                GTimeVal dateTime = {0, 0};
+                gchar *date;
+                date = g_match_info_fetch_named(match_info, "date");
+                g_warn_if_fail(RFC1123StrToTime(date, dateTime.tv_sec));
+                g_free(date);
+
+                gchar *iso = g_time_val_to_iso8601(&dateTime);
+                info.issued = iso;
+                if (info.updated.empty()) {
+                    info.updated = iso;
+                }
+                g_free(iso);
+            }
+            g_match_info_free(match_info);
+        }
+    }
+    // Clean structures
+    g_regex_unref(regexVer);
+    g_regex_unref(regexDate);
+
+    // Check if the update was updates since it was issued
+    if (info.issued.compare(info.updated) == 0) {
+        info.updated = "";
+    }
+
+    GPtrArray *urls;
+    urls = getBugzillaUrls(info.changelog);
+    for (guint i = 0; i < urls->len && urls->pdata[i] != NULL; ++i) {
+        info.bugzillaUrls.push_back(static_cast<const gchar*>(urls->pdata[i]));
+    }
+    g_ptr_array_unref(urls);
+
+    urls = getCVEUrls(info.changelog);
+    for (guint i = 0; i < urls->len && urls->pdata[i] != NULL; ++i) {
+        info.cveUrls.push_back(static_cast<const gchar*>(urls->pdata[i]));
+    }
+    g_ptr_array_unref(urls);
+}
+
+/**
+ * strv_from_vector:
+ *
+ * The strings are owned by the vector
+ */
+static vector<gchar*> strv_from_vector(const vector<string> &strings)
+{
+    vector<gchar*> ret;
+    for (vector<string>::const_iterator it = strings.begin(); it != strings.end(); ++it) {
+        ret.push_back(const_cast<gchar*>(it->c_str()));
+    }
+    ret.push_back(NULL);
+    return ret;
+}
+
 // used to emit packages it collects all the needed info
-void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
+void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver, const string &error)
 {
     // Verify if our update version is valid
     if (candver.end()) {
@@ -777,12 +1011,9 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
 
     pkgCache::VerFileIterator vf = candver.FileList();
     string origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
+    string filename = changelogCacheFile(*m_cache, candver);
     pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(candver.FileList());
 
-    string changelog;
-    string update_text;
-    string updated;
-    string issued;
     string srcpkg;
     if (rec.SourcePkg().empty()) {
         srcpkg = pkg.Name();
@@ -790,116 +1021,14 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
         srcpkg = rec.SourcePkg();
     }
 
-    // Create a random temp dir
-    char dirName[] = "/tmp/aptccXXXXXXXX";
-    char *tempDir = mkdtemp(dirName);
-    string filename = tempDir;
-    filename.append("/");
-    filename.append(pkg.Name());
-
-    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
-    if (pk_backend_is_online(backend)) {
-        // Create the download object
-        AcqPackageKitStatus Stat(this, m_job);
-
-        // get a fetcher
-        pkgAcquire fetcher;
-        fetcher.Setup(&Stat);
-
-        // fetch the changelog
-        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
-        if (downloadChangelog(*m_cache, fetcher, candver, filename)) {
-            ifstream in(filename.c_str());
-            string line;
-            GRegex *regexVer;
-            regexVer = g_regex_new("(?'source'.+) \\((?'version'.*)\\) "
-                                "(?'dist'.+); urgency=(?'urgency'.+)",
-                                G_REGEX_CASELESS,
-                                G_REGEX_MATCH_ANCHORED,
-                                0);
-            GRegex *regexDate;
-            regexDate = g_regex_new("^ -- (?'maintainer'.+) (?'mail'<.+>)  (?'date'.+)$",
-                                    G_REGEX_CASELESS,
-                                    G_REGEX_MATCH_ANCHORED,
-                                    0);
-
-            while (getline(in, line)) {
-                // we don't want the additional whitespace, because it can confuse
-                // some markdown parsers used by client tools
-                if (starts_with(line, "  "))
-                    line.erase(0,1);
-                // no need to free str later, it is allocated in a static buffer
-                const char *str = utf8(line.c_str());
-                if (strcmp(str, "") == 0) {
-                    changelog.append("\n");
-                    continue;
-                } else {
-                    changelog.append(str);
-                    changelog.append("\n");
-                }
-
-                if (starts_with(str, srcpkg.c_str())) {
-                    // Check to see if the the text isn't about the current package,
-                    // otherwise add a == version ==
-                    GMatchInfo *match_info;
-                    if (g_regex_match(regexVer, str, G_REGEX_MATCH_ANCHORED, &match_info)) {
-                        gchar *version;
-                        version = g_match_info_fetch_named(match_info, "version");
-
-                        // Compare if the current version is shown in the changelog, to not
-                        // display old changelog information
-                        if (_system != 0  &&
-                                _system->VS->DoCmpVersion(version, version + strlen(version),
-                                                        currver.VerStr(), currver.VerStr() + strlen(currver.VerStr())) <= 0) {
-                            g_free (version);
-                            break;
-                        } else {
-                            if (!update_text.empty()) {
-                                update_text.append("\n\n");
-                            }
-                            update_text.append(" == ");
-                            update_text.append(version);
-                            update_text.append(" ==");
-                            g_free (version);
-                        }
-                    }
-                    g_match_info_free (match_info);
-                } else if (starts_with(str, " ")) {
-                    // update descritption
-                    update_text.append("\n");
-                    update_text.append(str);
-                } else if (starts_with(str, " --")) {
-                    // Parse the text to know when the update was issued,
-                    // and when it got updated
-                    GMatchInfo *match_info;
-                    if (g_regex_match(regexDate, str, G_REGEX_MATCH_ANCHORED, &match_info)) {
-                        GTimeVal dateTime = {0, 0};
-                        gchar *date;
-                        date = g_match_info_fetch_named(match_info, "date");
-                        g_warn_if_fail(RFC1123StrToTime(date, dateTime.tv_sec));
-                        g_free(date);
-
-                        issued = g_time_val_to_iso8601(&dateTime);
-                        if (updated.empty()) {
-                            updated = g_time_val_to_iso8601(&dateTime);
-                        }
-                    }
-                    g_match_info_free(match_info);
-                }
-            }
-            // Clean structures
-            g_regex_unref(regexVer);
-            g_regex_unref(regexDate);
-            unlink(filename.c_str());
-            rmdir(tempDir);
-        } else if (_error->PendingError()) {
-            _error->PopMessage(changelog);
-        }
-    }
-
-    // Check if the update was updates since it was issued
-    if (issued.compare(updated) == 0) {
-        updated = "";
+    ChangelogInfo info;
+    if (m_cache->getChangelog(candver, info)) {
+        g_debug("Using the parsed changelog of %s", pkg.Name());
+    } else if (FileExists(filename)) {
+        parse_changelog(filename, srcpkg, currver, info);
+        m_cache->setChangelog(candver, info);
+    } else {
+        info.changelog = error;
     }
 
     // Build a package_id from the update version
@@ -927,46 +1056,164 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
     updates[0] = current_package_id;
     updates[1] = NULL;
 
-    GPtrArray *bugzilla_urls;
-    GPtrArray *cve_urls;
-    bugzilla_urls = getBugzillaUrls(changelog);
-    cve_urls = getCVEUrls(changelog);
+    vector<gchar*> bugzilla_urls = strv_from_vector(info.bugzillaUrls);
+    vector<gchar*> cve_urls = strv_from_vector(info.cveUrls);
 
     pk_backend_job_update_detail(m_job,
                              package_id,
                              updates,//const gchar *updates
                              NULL,//const gchar *obsoletes
                              NULL,//const gchar *vendor_url
-                             (gchar **) bugzilla_urls->pdata,// gchar **bugzilla_urls
-                             (gchar **) cve_urls->pdata,// gchar **cve_urls
+                             &bugzilla_urls[0],// gchar **bugzilla_urls
+                             &cve_urls[0],// gchar **cve_urls
                              restart,//PkRestartEnum restart
-                             update_text.c_str(),//const gchar *update_text
-                             changelog.c_str(),//const gchar *changelog
+                             info.updateText.c_str(),//const gchar *update_text
+                             info.changelog.c_str(),//const gchar *changelog
                              updateState,//PkUpdateStateEnum state
-                             issued.c_str(), //const gchar *issued_text
-                             updated.c_str() //const gchar *updated_text
+                             info.issued.c_str(), //const gchar *issued_text
+                             info.updated.c_str() //const gchar *updated_text
                              );
 
     g_free(package_id);
     g_strfreev(updates);
-    g_ptr_array_unref(bugzilla_urls);
-    g_ptr_array_unref(cve_urls);
+}
+
+void AptIntf::fetchChangelogs(const PkgList &pkgs, map<string, string> &errors)
+{
+    // Only download the changelogs that aren't cached yet
+    PkgList missing;
+    vector<string> files;
+    for (PkgList::const_iterator it = pkgs.begin(); it != pkgs.end(); ++it) {
+        if (it->end()) {
+            continue;
+        }
+        string filename = changelogCacheFile(*m_cache, *it);
+        if (!FileExists(filename) &&
+                std::find(files.begin(), files.end(), filename) == files.end()) {
+            missing.push_back(*it);
+            files.push_back(filename);
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    // Download next to the cache so the changelogs can be renamed into place
+    g_mkdir_with_parents(CHANGELOG_CACHE_DIR, 0755);
+    gchar *tempDir = g_strdup(CHANGELOG_CACHE_DIR "partial-XXXXXX");
+    if (g_mkdtemp(tempDir) == NULL) {
+        g_debug("Failed to create a directory in %s", CHANGELOG_CACHE_DIR);
+        g_free(tempDir);
+        return;
+    }
+
+    // Create the download object
+    AcqPackageKitStatus Stat(this, m_job);
+
+    // get a fetcher
+    pkgAcquire fetcher;
+    fetcher.Setup(&Stat);
+
+    // Queue all the changelogs so they are fetched in parallel
+    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
+    vector<string> partials;
+    vector<pkgAcquire::Item*> items;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        const pkgCache::PkgIterator &pkg = missing[i].ParentPkg();
+        string descr;
+        strprintf(descr, "Changelog for %s", pkg.Name());
+        partials.push_back(string(tempDir) + "/" + flNotDir(files[i]));
+
+        string uri = changelogUri(*m_cache, missing[i]);
+        g_debug("Trying to fetch '%s'", uri.c_str());
+        items.push_back(new pkgAcqFile(&fetcher, uri, "", 0, descr, pkg.Name(), "ignored", partials[i]));
+    }
+    fetcher.Run();
+
+    // Try the third-party-changelogs location for the ones that failed,
+    // Fetcher.Run() is "Continue" even if we get a 404
+    bool retry = false;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (m_cancel) {
+            break;
+        }
+        if (FileExists(partials[i])) {
+            continue;
+        }
+        errors[files[i]] = items[i]->ErrorText;
+
+        string uri;
+        const pkgCache::PkgIterator &pkg = missing[i].ParentPkg();
+        if (GuessThirdPartyChangelogUri(*m_cache, pkg, missing[i], uri)) {
+            string descr;
+            strprintf(descr, "Changelog for %s", pkg.Name());
+            g_debug("Trying to fetch '%s'", uri.c_str());
+            new pkgAcqFile(&fetcher, uri, "", 0, descr, pkg.Name(), "ignored", partials[i]);
+            retry = true;
+        }
+    }
+    if (retry && !m_cancel) {
+        fetcher.Run();
+    }
+
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (FileExists(partials[i])) {
+            if (g_rename(partials[i].c_str(), files[i].c_str()) == 0) {
+                errors.erase(files[i]);
+                continue;
+            }
+            unlink(partials[i].c_str());
+        }
+    }
+    g_rmdir(tempDir);
+    g_free(tempDir);
+
+    // The failures are reported in the details of each package
+    _error->Discard();
 }
 
 void AptIntf::emitUpdateDetails(const PkgList &pkgs)
 {
+    map<string, string> errors;
+    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
+    if (pk_backend_is_online(backend)) {
+        fetchChangelogs(pkgs, errors);
+    }
+
     for (PkgList::const_iterator it = pkgs.begin(); it != pkgs.end(); ++it) {
         if (m_cancel) {
             break;
         }
 
-        emitUpdateDetail(*it);
+        string error;
+        if (!it->end()) {
+            map<string, string>::const_iterator err = errors.find(changelogCacheFile(*m_cache, *it));
+            if (err != errors.end()) {
+                error = err->second;
+            }
+        }
+        emitUpdateDetail(*it, error);
     }
 }
 
 void AptIntf::getDepends(PkgList &output,
                          const pkgCache::VerIterator &ver,
                          bool recursive)
+{
+    // Don't add what is already on the list
+    vector<bool> visited(m_cache->GetPkgCache()->HeaderP->PackageCount, false);
+    if (recursive) {
+        for (PkgList::const_iterator it = output.begin(); it != output.end(); ++it) {
+            visited[it->ParentPkg().Index()] = true;
+        }
+    }
+    getDepends(output, ver, recursive, visited);
+}
+
+void AptIntf::getDepends(PkgList &output,
+                         const pkgCache::VerIterator &ver,
+                         bool recursive,
+                         vector<bool> &visited)
 {
     pkgCache::DepIterator dep = ver.DependsList();
     while (!dep.end()) {
@@ -981,9 +1228,10 @@ void AptIntf::getDepends(PkgList &output,
             continue;
         } else if (dep->Type == pkgCache::Dep::Depends) {
             if (recursive) {
-                if (!output.contains(dep.TargetPkg())) {
+                if (!visited[dep.TargetPkg().Index()]) {
+                    visited[dep.TargetPkg().Index()] = true;
                     output.push_back(ver);
-                    getDepends(output, ver, recursive);
+                    getDepends(output, ver, recursive, visited);
                 }
             } else {
                 output.push_back(ver);
@@ -997,34 +1245,43 @@ void AptIntf::getRequires(PkgList &output,
                           const pkgCache::VerIterator &ver,
                           bool recursive)
 {
-    for (pkgCache::PkgIterator parentPkg = m_cache->GetPkgCache()->PkgBegin(); !parentPkg.end(); ++parentPkg) {
+    // Dependencies are followed to the version findVer() returns
+    if (ver != m_cache->findVer(ver.ParentPkg())) {
+        return;
+    }
+
+    // Don't add what is already on the list
+    vector<bool> visited(m_cache->GetPkgCache()->HeaderP->PackageCount, false);
+    if (recursive) {
+        for (PkgList::const_iterator it = output.begin(); it != output.end(); ++it) {
+            visited[it->ParentPkg().Index()] = true;
+        }
+    }
+    getRequires(output, ver.ParentPkg().Index(), recursive, m_cache->GetRevDepends(), visited);
+}
+
+void AptIntf::getRequires(PkgList &output,
+                          unsigned long pkg,
+                          bool recursive,
+                          const RevDepends *revDepends,
+                          vector<bool> &visited)
+{
+    pkgCache *cache = m_cache->GetPkgCache();
+    for (unsigned long i = revDepends->offsets[pkg]; i < revDepends->offsets[pkg + 1]; ++i) {
         if (m_cancel) {
             break;
         }
 
-        // Ignore packages that exist only due to dependencies.
-        if (parentPkg.VersionList().end() && parentPkg.ProvidesList().end()) {
+        unsigned long parent = revDepends->parents[i];
+        if (recursive && visited[parent]) {
             continue;
         }
+        visited[parent] = true;
 
-        // Don't insert virtual packages instead add what it provides
-        const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
-        if (parentVer.end() == false) {
-            PkgList deps;
-            getDepends(deps, parentVer, false);
-            for (PkgList::const_iterator it = deps.begin(); it != deps.end(); ++it) {
-                if (*it == ver) {
-                    if (recursive) {
-                        if (!output.contains(parentPkg)) {
-                            output.push_back(parentVer);
-                            getRequires(output, parentVer, recursive);
-                        }
-                    } else {
-                        output.push_back(parentVer);
-                    }
-                    break;
-                }
-            }
+        const pkgCache::VerIterator &parentVer = m_cache->findVer(pkgCache::PkgIterator(*cache, cache->PkgP + parent));
+        output.push_back(parentVer);
+        if (recursive) {
+            getRequires(output, parent, recursive, revDepends, visited);
         }
     }
 }
@@ -1135,36 +1392,37 @@ PkgList AptIntf::getPackagesFromGroup(gchar **values)
 
     pk_backend_job_set_allow_cancel(m_job, true);
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
+    return scanPackages(&AptIntf::scanPackageGroup, &groups);
+}
 
-        // Ignore virtual packages
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            string section = pkg.VersionList().Section() == NULL ? "" : pkg.VersionList().Section();
+void AptIntf::scanPackageGroup(const pkgCache::PkgIterator &pkg,
+                               pkgRecords &records,
+                               PkgList &output,
+                               gpointer data)
+{
+    const vector<PkGroupEnum> &groups = *static_cast<vector<PkGroupEnum>*>(data);
 
-            size_t found;
-            found = section.find_last_of("/");
-            section = section.substr(found + 1);
+    // Ignore virtual packages
+    const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+    if (ver.end() == false) {
+        const char *section = pkg.VersionList().Section();
+        if (section == NULL) {
+            section = "";
+        } else if (strrchr(section, '/') != NULL) {
+            section = strrchr(section, '/') + 1;
+        }
 
-            // Don't insert virtual packages instead add what it provides
-            for (vector<PkGroupEnum>::const_iterator it = groups.begin();
-                 it != groups.end();
-                 ++it) {
-                if (*it == get_enum_group(section)) {
-                    output.push_back(ver);
-                    break;
-                }
+        // Don't insert virtual packages instead add what it provides
+        PkGroupEnum group = get_enum_group(section);
+        for (vector<PkGroupEnum>::const_iterator it = groups.begin();
+             it != groups.end();
+             ++it) {
+            if (*it == group) {
+                output.push_back(ver);
+                break;
             }
         }
     }
-    return output;
 }
 
 PkgList AptIntf::searchPackageName(gchar *search)
@@ -1221,96 +1479,189 @@ PkgList AptIntf::searchPackageDetails(gchar *search)
         return output;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
+    // Only the packages whose words contain the plain search terms need
+    // their descriptions matched, and those that were not indexed
+    DescriptionIndex index;
+    vector<string> literals = matcher->literals();
+    if (literals.empty()) {
+        output = scanPackages(&AptIntf::scanPackageDetails, matcher);
+    } else if (index.open()) {
+        vector<bool> candidates;
+        index.find(literals, candidates);
+
+        vector<pkgCache::PkgIterator> pkgs;
+        for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+            if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+                continue;
+            }
+            int i = index.lookup(pkg.Name());
+            if (i < 0 || candidates[i]) {
+                pkgs.push_back(pkg);
+            }
+        }
+        output = scanPackages(pkgs, &AptIntf::scanPackageDetails, matcher);
+    } else {
+        // The packages changed since the index was built
+        DescriptionIndex::buildInBackground();
+        output = scanPackages(&AptIntf::scanPackageDetails, matcher);
+    }
+
+    delete matcher;
+    return output;
+}
+
+void AptIntf::scanPackageDetails(const pkgCache::PkgIterator &pkg,
+                                 pkgRecords &records,
+                                 PkgList &output,
+                                 gpointer data)
+{
+    Matcher *matcher = static_cast<Matcher*>(data);
+
+    const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+    if (ver.end() == false) {
+        if (matcher->matches(pkg.Name()) ||
+                matcher->matches(AptCacheFile::getLongDescription(ver, records))) {
+            // The package matched
+            output.push_back(ver);
+        }
+    } else if (matcher->matches(pkg.Name())) {
+        // The package is virtual and MATCHED the name
+        // Don't insert virtual packages instead add what it provides
+
+        // iterate over the provides list
+        for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
+            const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
+
+            // check to see if the provided package isn't virtual too
+            if (ownerVer.end() == false) {
+                // we add the package now because we will need to
+                // remove duplicates later anyway
+                output.push_back(ownerVer);
+            }
         }
+    }
+}
+
+struct AptIntf::ScanChunk {
+    AptIntf *apt;
+    ScanFunc func;
+    gpointer data;
+    const vector<pkgCache::PkgIterator> *pkgs;
+    size_t begin;
+    size_t end;
+    locale_t locale;
+    PkgList output;
+};
+
+PkgList AptIntf::scanPackages(ScanFunc func, gpointer data)
+{
+    vector<pkgCache::PkgIterator> pkgs;
+    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         // Ignore packages that exist only due to dependencies.
         if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
             continue;
         }
+        pkgs.push_back(pkg);
+    }
+    return scanPackages(pkgs, func, data);
+}
 
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            if (matcher->matches(pkg.Name()) ||
-                    matcher->matches((*m_cache).getLongDescription(ver))) {
-                // The package matched
-                output.push_back(ver);
-            }
-        } else if (matcher->matches(pkg.Name())) {
-            // The package is virtual and MATCHED the name
-            // Don't insert virtual packages instead add what it provides
+PkgList AptIntf::scanPackages(const vector<pkgCache::PkgIterator> &pkgs, ScanFunc func, gpointer data)
+{
+    PkgList output;
 
-            // iterate over the provides list
-            for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
-                const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
+    // The policy and the dependency cache are built on demand, make
+    // sure that doesn't happen from the threads
+    m_cache->GetDepCache();
 
-                // check to see if the provided package isn't virtual too
-                if (ownerVer.end() == false) {
-                    // we add the package now because we will need to
-                    // remove duplicates later anyway
-                    output.push_back(ownerVer);
-                }
-            }
-        }
+    // Don't start threads for a handful of packages
+    guint n_chunks = MIN(g_get_num_processors(), (guint) (pkgs.size() / 1000 + 1));
+    vector<ScanChunk> chunks(n_chunks);
+    for (guint i = 0; i < n_chunks; ++i) {
+        chunks[i].apt = this;
+        chunks[i].func = func;
+        chunks[i].data = data;
+        chunks[i].pkgs = &pkgs;
+        chunks[i].begin = pkgs.size() * i / n_chunks;
+        chunks[i].end = pkgs.size() * (i + 1) / n_chunks;
+        chunks[i].locale = uselocale((locale_t) 0);
+    }
+
+    // The first chunk is scanned by this thread
+    vector<GThread*> threads;
+    for (guint i = 1; i < n_chunks; ++i) {
+        threads.push_back(g_thread_new("aptcc-scan", scanThread, &chunks[i]));
+    }
+    scanThread(&chunks[0]);
+    for (vector<GThread*>::const_iterator it = threads.begin(); it != threads.end(); ++it) {
+        g_thread_join(*it);
+    }
+
+    for (guint i = 0; i < n_chunks; ++i) {
+        output.insert(output.end(), chunks[i].output.begin(), chunks[i].output.end());
     }
     return output;
 }
 
-// used to return files it reads, using the info from the files in /var/lib/dpkg/info/
+gpointer AptIntf::scanThread(gpointer data)
+{
+    ScanChunk *chunk = static_cast<ScanChunk*>(data);
+
+    // Translated descriptions depend on the locale of the job
+    uselocale(chunk->locale);
+
+    // pkgRecords keeps the file it last parsed open, so it can't be shared
+    pkgRecords records(*chunk->apt->m_cache);
+    for (size_t i = chunk->begin; i < chunk->end; ++i) {
+        if (chunk->apt->m_cancel) {
+            break;
+        }
+        (chunk->apt->*chunk->func)((*chunk->pkgs)[i], records, chunk->output, chunk->data);
+    }
+    return NULL;
+}
+
 PkgList AptIntf::searchPackageFiles(gchar **values)
 {
     PkgList output;
-    vector<string> packages;
-    regex_t re;
-    gchar *search;
-    gchar *values_str;
-
-    values_str = g_strjoinv("$|^", values);
-    search = g_strdup_printf("^%s$",
-                             values_str);
-    g_free(values_str);
-    if(regcomp(&re, search, REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
-        g_free(search);
-        return output;
-    }
-    g_free(search);
+    std::set<string> packages;
 
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
-        regfree(&re);
+    DpkgFileIndex index;
+    if (!index.open()) {
         return output;
     }
 
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
+    for (uint i = 0; values[i] != NULL; ++i) {
         if (m_cancel) {
             break;
         }
-        if (ends_with(dirp->d_name, ".list")) {
-            string f = "/var/lib/dpkg/info/" + string(dirp->d_name);
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
-            }
-            while (!in.eof()) {
-                getline(in, line);
-                if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                    string file(dirp->d_name);
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
-                    break;
-                }
+
+        // Plain paths and file names are looked up in the index,
+        // anything else is matched against every path like before
+        if (strpbrk(values[i], "*?[]^$|\\") == NULL) {
+            if (values[i][0] == '/') {
+                index.findPath(values[i], packages);
+            } else {
+                index.findBasename(values[i], packages);
             }
+            continue;
+        }
+
+        regex_t re;
+        gchar *search = g_strdup_printf("^%s$", values[i]);
+        if (regcomp(&re, search, REG_NOSUB) != 0) {
+            g_debug("Regex compilation error");
+            g_free(search);
+            continue;
         }
+        g_free(search);
+
+        index.findRegex(&re, packages);
+        regfree(&re);
     }
-    closedir(dp);
-    regfree(&re);
 
     // Resolve the package names now
-    for (vector<string>::const_iterator it = packages.begin();
+    for (std::set<string>::const_iterator it = packages.begin();
         it != packages.end(); ++it) {
         if (m_cancel) {
             break;
@@ -1333,6 +1684,17 @@ PkgList AptIntf::getUpdates(PkgList &blocked)
 {
     PkgList updates;
 
+    // The result only depends on the package cache
+    if (m_cache->getUpdates(updates, blocked)) {
+        g_debug("Using the updates computed by a previous job");
+        return updates;
+    }
+
+    // Marking the upgrades must not change what other jobs see
+    if (!m_cache->detachDepCache()) {
+        return updates;
+    }
+
     if (m_cache->DistUpgrade() == false) {
         m_cache->ShowBroken(false);
         g_debug("Internal error, DistUpgrade broke stuff");
@@ -1356,72 +1718,20 @@ PkgList AptIntf::getUpdates(PkgList &blocked)
         }
     }
 
+    m_cache->setUpdates(updates, blocked);
     return updates;
 }
 
 // used to return files it reads, using the info from the files in /var/lib/dpkg/info/
 void AptIntf::providesMimeType(PkgList &output, gchar **values)
 {
-    regex_t re;
-    gchar *value;
-    gchar *values_str;
-
-    values_str = g_strjoinv("|", values);
-    value = g_strdup_printf("^MimeType=\\(.*;\\)\\?\\(%s\\)\\(;.*\\)\\?$",
-                            values_str);
-    g_free(values_str);
-
-    if(regcomp(&re, value, REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
-        g_free(value);
-        return;
-    }
-    g_free(value);
-
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/usr/share/app-install/desktop/"))) {
-        g_debug ("Error opening /usr/share/app-install/desktop/\n");
-        regfree(&re);
-        return;
+    std::set<string> packages;
+    if (!MimeIndex::findPackages(values, packages)) {
+        g_debug("Error opening %s", APP_INSTALL_DESKTOP_DIR);
     }
 
-    vector<string> packages;
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
-        if (m_cancel) {
-            break;
-        }
-        if (ends_with(dirp->d_name, ".desktop")) {
-            string f = "/usr/share/app-install/desktop/" + string(dirp->d_name);
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
-            }
-            bool getName = false;
-            while (!in.eof()) {
-                getline(in, line);
-                if (getName) {
-                    if (starts_with(line, "X-AppInstall-Package=")) {
-                        // Remove the X-AppInstall-Package=
-                        packages.push_back(line.substr(21));
-                        break;
-                    }
-                } else {
-                    if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                        in.seekg(ios_base::beg);
-                        getName = true;
-                    }
-                }
-            }
-        }
-    }
-
-    closedir(dp);
-    regfree(&re);
-
     // resolve the package names
-    for (vector<string>::const_iterator it = packages.begin();
+    for (std::set<string>::const_iterator it = packages.begin();
          it != packages.end(); ++it) {
         if (m_cancel) {
             break;
@@ -2153,6 +2463,9 @@ void AptIntf::refreshCache()
         // TODO this shouldn't 
         show_errors(m_job, PK_ERROR_ENUM_GPG_FAILURE);
     }
+
+    // Index the new descriptions without delaying the end of the transaction
+    DescriptionIndex::buildInBackground();
 }
 
 void AptIntf::markAutoInstalled(const PkgList &pkgs)
@@ -2379,6 +2692,12 @@ bool AptIntf::runTransaction(const PkgList &install, const PkgList &remove, bool
         BrokenFix = true;
     }
 
+    // Never mark the dependency cache other jobs are reading, this is a
+    // no-op if the job already has its own
+    if (!m_cache->detachDepCache()) {
+        return false;
+    }
+
     pkgProblemResolver Fix(*m_cache);
 
     // new scope for the ActionGroup
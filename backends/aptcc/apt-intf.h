@@ -31,6 +31,8 @@
 
 #include <pk-backend.h>
 
+#include <map>
+
 #include "PkgList.h"
 #include "apt-sourceslist.h"
 
@@ -41,6 +43,19 @@
 class pkgProblemResolver;
 class Matcher;
 class AptCacheFile;
+struct RevDepends;
+
+/**
+ * Makes the job thread use the locale of the job while it is in scope,
+ * so the next job on the thread doesn't inherit it
+ */
+class AptJobLocale
+{
+public:
+    AptJobLocale(PkBackendJob *job);
+    ~AptJobLocale();
+};
+
 class AptIntf
 {
 public:
@@ -194,13 +209,19 @@ public:
     /**
       * Emits update detail
       */
-    void emitUpdateDetail(const pkgCache::VerIterator &candver);
+    void emitUpdateDetail(const pkgCache::VerIterator &candver, const string &error);
 
     /**
       * Emits update datails for the given list
       */
     void emitUpdateDetails(const PkgList &pkgs);
 
+    /**
+      * Downloads the changelogs of the packages that aren't cached yet
+      * all at once, the errors are stored by cache file
+      */
+    void fetchChangelogs(const PkgList &pkgs, map<string, string> &errors);
+
     /**
       *  Emits the files of a package
       */
@@ -244,6 +265,38 @@ public:
     AptCacheFile* aptCacheFile() const;
 
 private:
+    struct ScanChunk;
+    typedef void (AptIntf::*ScanFunc)(const pkgCache::PkgIterator &pkg,
+                                      pkgRecords &records,
+                                      PkgList &output,
+                                      gpointer data);
+
+    /**
+     *  calls func for each package that doesn't exist only due to
+     *  dependencies, split across one thread per CPU, and returns the
+     *  output in the order of the package cache
+     */
+    PkgList scanPackages(ScanFunc func, gpointer data);
+    PkgList scanPackages(const vector<pkgCache::PkgIterator> &pkgs, ScanFunc func, gpointer data);
+    static gpointer scanThread(gpointer data);
+    void getDepends(PkgList &output,
+                    const pkgCache::VerIterator &ver,
+                    bool recursive,
+                    vector<bool> &visited);
+    void getRequires(PkgList &output,
+                     unsigned long pkg,
+                     bool recursive,
+                     const RevDepends *revDepends,
+                     vector<bool> &visited);
+    void scanPackageGroup(const pkgCache::PkgIterator &pkg,
+                          pkgRecords &records,
+                          PkgList &output,
+                          gpointer data);
+    void scanPackageDetails(const pkgCache::PkgIterator &pkg,
+                            pkgRecords &records,
+                            PkgList &output,
+                            gpointer data);
+
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
     bool packageIsSupported(const pkgCache::VerIterator &verIter, string component);
     bool isApplication(const pkgCache::VerIterator &verIter);
@@ -256,6 +309,9 @@ private:
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
     AptCacheFile *m_cache;
+    bool       m_sharedCache;
+    bool       m_exclusive;
+    bool       m_locked;
     PkBackendJob  *m_job;
     bool       m_cancel;
     struct stat m_restartStat;
@@ -23,6 +23,7 @@
 #include "pkg_acqfile.h"
 
 #include <glib/gstdio.h>
+#include <sys/stat.h>
 
 #include <fstream>
 
@@ -133,8 +134,7 @@ string GetChangelogPath(AptCacheFile &Cache,
 {
    string path;
 
-   pkgRecords Recs(Cache);
-   pkgRecords::Parser &rec=Recs.Lookup(Ver.FileList());
+   pkgRecords::Parser &rec=Cache.GetPkgRecords()->Lookup(Ver.FileList());
    string srcpkg = rec.SourcePkg().empty() ? Pkg.Name() : rec.SourcePkg();
    string ver = Ver.VerStr();
    // if there is a source version it always wins
@@ -185,69 +185,41 @@ bool GuessThirdPartyChangelogUri(AptCacheFile &Cache,
    return true;
 }
 
-bool downloadChangelog(AptCacheFile &CacheFile,
-                       pkgAcquire &Fetcher,
-                       pkgCache::VerIterator Ver,
-                       string targetfile)
-/* Download a changelog file for the given package version to
- * targetfile. This will first try the server from Apt::Changelogs::Server
- * (http://metadata.ftp-master.debian.org/changelogs by default) and if that gives
- * a 404 tries to get it from the archive directly (see
+string changelogUri(AptCacheFile &CacheFile,
+                    pkgCache::VerIterator Ver)
+/* Returns the changelog url on the server from Apt::Changelogs::Server
+ * (http://metadata.ftp-master.debian.org/changelogs by default), if that
+ * gives a 404 it can be fetched from the archive directly (see
  * GuessThirdPartyChangelogUri for details how)
  */
 {
    string path;
-   string descr;
    string server;
    string changelog_uri;
    string origin;
 
-   if (!Ver.end()) {
-        pkgCache::VerFileIterator vf = Ver.FileList();
-        origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
-    }
-
-   // data structures we need
-   pkgCache::PkgIterator Pkg = Ver.ParentPkg();
+   pkgCache::VerFileIterator vf = Ver.FileList();
+   origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
 
    // make the server root configurable
    server = _config->Find("Apt::Changelogs::Server",
                           "http://metadata.ftp-master.debian.org/changelogs");
-   path = GetChangelogPath(CacheFile, Pkg, Ver);
+   path = GetChangelogPath(CacheFile, Ver.ParentPkg(), Ver);
 
    if (origin.compare("Ubuntu") == 0)
        strprintf(changelog_uri, "%s/%s/%s/changelog", server.c_str(), "pool", path.c_str());
    else
        strprintf(changelog_uri, "%s/%s_changelog", server.c_str(), path.c_str());
 
-   g_debug("Trying to fetch '%s'", changelog_uri.c_str());
-   strprintf(descr, "Changelog for %s", Pkg.Name());
-   // queue it
-   new pkgAcqFile(&Fetcher, changelog_uri, "", 0, descr, Pkg.Name(), "ignored", targetfile);
-
-   // try downloading it, if that fails, try third-party-changelogs location
-   // FIXME: Fetcher.Run() is "Continue" even if I get a 404?!?
-   Fetcher.Run();
-   if (!FileExists(targetfile)) {
-        string third_party_uri;
-        if (GuessThirdPartyChangelogUri(CacheFile, Pkg, Ver, third_party_uri)) {
-            g_debug("Trying to fetch '%s'", third_party_uri.c_str());
-            strprintf(descr, "Changelog for %s", Pkg.Name());
-            new pkgAcqFile(&Fetcher, third_party_uri, "", 0, descr, Pkg.Name(), "ignored", targetfile);
-            Fetcher.Run();
-        }
-   }
-
-   if (FileExists(targetfile)) {
-        return true;
-   }
+   return changelog_uri;
+}
 
-   // error
-   pkgRecords Recs(CacheFile);
-   pkgRecords::Parser &rec=Recs.Lookup(Ver.FileList());
-   string srcpkg = rec.SourcePkg().empty() ? Pkg.Name() : rec.SourcePkg();
-   strprintf(descr, "Changelog for this version is not yet available");
-   return false;
+string changelogCacheFile(AptCacheFile &CacheFile,
+                          pkgCache::VerIterator Ver)
+{
+    // The changelog is the same for all the binaries of a source version
+    string path = GetChangelogPath(CacheFile, Ver.ParentPkg(), Ver);
+    return string(CHANGELOG_CACHE_DIR) + flNotDir(path) + ".changelog";
 }
 
 void getChangelogFile(const string &filename,
@@ -397,6 +369,15 @@ bool starts_with(const string &str, const char *start)
     return str.size() >= startSize && (strncmp(str.data(), start, startSize) == 0);
 }
 
+gint64 utilFileMtime(const char *filename)
+{
+    struct stat buf;
+    if (stat(filename, &buf) != 0) {
+        return 0;
+    }
+    return (gint64) buf.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + buf.st_mtim.tv_nsec;
+}
+
 bool utilRestartRequired(const string &packageName)
 {
     if (starts_with(packageName, "linux-image-") ||
@@ -33,6 +33,8 @@
 
 using namespace std;
 
+#define CHANGELOG_CACHE_DIR "/var/cache/PackageKit/aptcc/changelogs/"
+
 /**
   * Return the PkEnumGroup of the give group string.
   */
@@ -49,10 +51,25 @@ void getChangelogFile(const string &filename,
                       const string &uri,
                       pkgAcquire *fetcher);
 
-bool downloadChangelog(AptCacheFile &CacheFile,
-                       pkgAcquire &Fetcher, 
-                       pkgCache::VerIterator Ver,
-                       string targetfile);
+/**
+  * Returns the URI of the changelog on the changelogs server
+  */
+string changelogUri(AptCacheFile &CacheFile,
+                    pkgCache::VerIterator Ver);
+
+/**
+  * Returns the URI of the changelog next to the package in its archive
+  */
+bool GuessThirdPartyChangelogUri(AptCacheFile &Cache,
+                                 pkgCache::PkgIterator Pkg,
+                                 pkgCache::VerIterator Ver,
+                                 string &out_uri);
+
+/**
+  * Returns where the changelog of the source version of Ver is cached
+  */
+string changelogCacheFile(AptCacheFile &CacheFile,
+                          pkgCache::VerIterator Ver);
 
 /**
   * Returns a list of links pairs url;description for CVEs
@@ -74,6 +91,12 @@ bool ends_with(const string &str, const char *end);
   */
 bool starts_with(const string &str, const char *end);
 
+/**
+  * Return the modification time of the given file in nanoseconds,
+  * or 0 if it can't be read
+  */
+gint64 utilFileMtime(const char *filename);
+
 /**
   * Return true if the given package name is on the list of packages that require a restart
   */
@@ -0,0 +1,387 @@
+/* description-index.cpp
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "description-index.h"
+
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "apt-utils.h"
+
+#define DESCRIPTION_INDEX_MAGIC "PKDIDX1"
+
+/*
+ * The file starts with the header, followed by the sorted package names,
+ * the words, the postings of each word and the NUL terminated strings.
+ */
+struct DescriptionIndex::Header {
+    char magic[8];
+    gint64 listsMtime;
+    gint64 statusMtime;
+    guint32 nNames;
+    guint32 nWords;
+    guint32 nPostings;
+    guint32 stringsSize;
+};
+
+struct DescriptionIndex::Word {
+    guint32 offset;
+    guint32 first;
+    guint32 count;
+};
+
+// The thread building the index, guarded by buildLock
+static GMutex buildLock;
+static GThread *buildThreadHandle = NULL;
+static bool buildRunning = false;
+static volatile gint buildCancel = 0;
+
+static void index_stamp(gint64 &listsMtime, gint64 &statusMtime)
+{
+    listsMtime = utilFileMtime(_config->FindDir("Dir::State::Lists").c_str());
+    statusMtime = utilFileMtime(_config->FindFile("Dir::State::status").c_str());
+}
+
+DescriptionIndex::DescriptionIndex() :
+    m_data(0),
+    m_size(0)
+{
+}
+
+DescriptionIndex::~DescriptionIndex()
+{
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+bool DescriptionIndex::open()
+{
+    int fd = ::open(DESCRIPTION_INDEX, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat buf;
+    if (fstat(fd, &buf) != 0 || (size_t) buf.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const char*>(data);
+    m_size = buf.st_size;
+
+    gint64 listsMtime;
+    gint64 statusMtime;
+    index_stamp(listsMtime, statusMtime);
+
+    const Header *head = header();
+    size_t size = sizeof(Header) +
+            head->nNames * sizeof(guint32) +
+            head->nWords * sizeof(Word) +
+            head->nPostings * sizeof(guint32) +
+            head->stringsSize;
+    if (memcmp(head->magic, DESCRIPTION_INDEX_MAGIC, sizeof(head->magic)) != 0 ||
+            size != m_size ||
+            head->stringsSize == 0 ||
+            strings()[head->stringsSize - 1] != '\0' ||
+            head->listsMtime != listsMtime ||
+            head->statusMtime != statusMtime) {
+        munmap(data, m_size);
+        m_data = 0;
+        m_size = 0;
+        return false;
+    }
+
+    return true;
+}
+
+int DescriptionIndex::lookup(const char *name) const
+{
+    guint32 low = 0;
+    guint32 high = header()->nNames;
+    while (low < high) {
+        guint32 mid = low + (high - low) / 2;
+        int ret = strcmp(strings() + names()[mid], name);
+        if (ret == 0) {
+            return mid;
+        } else if (ret < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return -1;
+}
+
+void DescriptionIndex::find(const vector<string> &literals, vector<bool> &candidates) const
+{
+    candidates.assign(header()->nNames, true);
+
+    vector<bool> found;
+    for (vector<string>::const_iterator it = literals.begin(); it != literals.end(); ++it) {
+        found.assign(header()->nNames, false);
+        for (guint32 i = 0; i < header()->nWords; ++i) {
+            const Word &word = words()[i];
+            if (strstr(strings() + word.offset, it->c_str()) == NULL) {
+                continue;
+            }
+            for (guint32 j = word.first; j < word.first + word.count; ++j) {
+                found[postings()[j]] = true;
+            }
+        }
+
+        for (guint32 i = 0; i < header()->nNames; ++i) {
+            candidates[i] = candidates[i] && found[i];
+        }
+    }
+}
+
+void DescriptionIndex::buildInBackground()
+{
+    g_mutex_lock(&buildLock);
+    if (!buildRunning) {
+        // Reap the thread that built the index last time
+        if (buildThreadHandle) {
+            g_thread_join(buildThreadHandle);
+        }
+        g_atomic_int_set(&buildCancel, 0);
+        buildRunning = true;
+        buildThreadHandle = g_thread_new("aptcc-index", buildThread, NULL);
+    }
+    g_mutex_unlock(&buildLock);
+}
+
+void DescriptionIndex::stopBackground()
+{
+    g_mutex_lock(&buildLock);
+    GThread *thread = buildThreadHandle;
+    buildThreadHandle = NULL;
+    g_atomic_int_set(&buildCancel, 1);
+    g_mutex_unlock(&buildLock);
+
+    if (thread) {
+        g_thread_join(thread);
+    }
+}
+
+gpointer DescriptionIndex::buildThread(gpointer data)
+{
+    build();
+
+    g_mutex_lock(&buildLock);
+    buildRunning = false;
+    g_mutex_unlock(&buildLock);
+    return NULL;
+}
+
+/**
+ * Adds the words of the text to the package, interning new ones
+ */
+static void index_add_words(const string &text,
+                            guint32 name,
+                            GHashTable *wordIds,
+                            vector<const char*> &words,
+                            vector<std::pair<guint32, guint32> > &postings)
+{
+    string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && !g_ascii_isspace(text[i])) {
+            word += g_ascii_tolower(text[i]);
+            continue;
+        }
+        if (word.empty()) {
+            continue;
+        }
+
+        gpointer id = g_hash_table_lookup(wordIds, word.c_str());
+        if (id == NULL) {
+            gchar *tmp = g_strdup(word.c_str());
+            words.push_back(tmp);
+            id = GUINT_TO_POINTER(words.size());
+            g_hash_table_insert(wordIds, tmp, id);
+        }
+        postings.push_back(std::make_pair(GPOINTER_TO_UINT(id) - 1, name));
+        word.clear();
+    }
+}
+
+bool DescriptionIndex::build()
+{
+    gint64 listsMtime;
+    gint64 statusMtime;
+    index_stamp(listsMtime, statusMtime);
+
+    // Only the package cache is needed, not the policy or the depcache
+    pkgCacheFile cache;
+    if (cache.BuildCaches(NULL, false) == false) {
+        _error->Discard();
+        return false;
+    }
+    pkgCache *Cache = cache.GetPkgCache();
+    pkgRecords records(cache);
+
+    // Number the package names in sorted order so they can be bisected
+    std::map<string, guint32> names;
+    for (pkgCache::PkgIterator pkg = Cache->PkgBegin(); !pkg.end(); ++pkg) {
+        names[pkg.Name()] = 0;
+    }
+    guint32 n = 0;
+    for (std::map<string, guint32>::iterator it = names.begin(); it != names.end(); ++it) {
+        it->second = n++;
+    }
+
+    GHashTable *wordIds = g_hash_table_new(g_str_hash, g_str_equal);
+    vector<const char*> words;
+    vector<std::pair<guint32, guint32> > postings;
+    for (pkgCache::PkgIterator pkg = Cache->PkgBegin(); !pkg.end(); ++pkg) {
+        if (g_atomic_int_get(&buildCancel)) {
+            break;
+        }
+
+        guint32 name = names[pkg.Name()];
+        index_add_words(pkg.Name(), name, wordIds, words, postings);
+
+        // Every description in every language, as the search only uses
+        // the one matching the locale of the transaction
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            for (pkgCache::DescIterator desc = ver.DescriptionList(); !desc.end(); ++desc) {
+                pkgCache::DescFileIterator df = desc.FileList();
+                if (!df.end()) {
+                    index_add_words(records.Lookup(df).LongDesc(), name, wordIds, words, postings);
+                }
+            }
+        }
+    }
+    g_hash_table_unref(wordIds);
+
+    bool ret = false;
+    if (!g_atomic_int_get(&buildCancel)) {
+        std::sort(postings.begin(), postings.end());
+        postings.erase(std::unique(postings.begin(), postings.end()), postings.end());
+
+        string pool;
+        vector<guint32> nameTable;
+        for (std::map<string, guint32>::const_iterator it = names.begin(); it != names.end(); ++it) {
+            nameTable.push_back(pool.size());
+            pool.append(it->first.c_str(), it->first.size() + 1);
+        }
+
+        vector<Word> wordTable(words.size());
+        vector<guint32> postingTable;
+        postingTable.reserve(postings.size());
+        for (size_t i = 0; i < words.size(); ++i) {
+            wordTable[i].offset = pool.size();
+            wordTable[i].first = 0;
+            wordTable[i].count = 0;
+            pool.append(words[i], strlen(words[i]) + 1);
+        }
+        for (size_t i = 0; i < postings.size(); ++i) {
+            Word &word = wordTable[postings[i].first];
+            if (word.count == 0) {
+                word.first = postingTable.size();
+            }
+            word.count++;
+            postingTable.push_back(postings[i].second);
+        }
+        pool.push_back('\0');
+
+        Header head;
+        memset(&head, 0, sizeof(head));
+        memcpy(head.magic, DESCRIPTION_INDEX_MAGIC, sizeof(head.magic));
+        head.listsMtime = listsMtime;
+        head.statusMtime = statusMtime;
+        head.nNames = nameTable.size();
+        head.nWords = wordTable.size();
+        head.nPostings = postingTable.size();
+        head.stringsSize = pool.size();
+
+        string buffer((const char*) &head, sizeof(head));
+        if (!nameTable.empty()) {
+            buffer.append((const char*) &nameTable[0], nameTable.size() * sizeof(guint32));
+        }
+        if (!wordTable.empty()) {
+            buffer.append((const char*) &wordTable[0], wordTable.size() * sizeof(Word));
+        }
+        if (!postingTable.empty()) {
+            buffer.append((const char*) &postingTable[0], postingTable.size() * sizeof(guint32));
+        }
+        buffer.append(pool);
+
+        GError *error = NULL;
+        gchar *dirname = g_path_get_dirname(DESCRIPTION_INDEX);
+        g_mkdir_with_parents(dirname, 0755);
+        g_free(dirname);
+        ret = g_file_set_contents(DESCRIPTION_INDEX, buffer.data(), buffer.size(), &error);
+        if (ret) {
+            g_debug("Indexed %zu words of %zu packages", words.size(), names.size());
+        } else {
+            g_debug("Failed to save the description index: %s", error->message);
+            g_error_free(error);
+        }
+    }
+
+    for (vector<const char*>::iterator it = words.begin(); it != words.end(); ++it) {
+        g_free((gpointer) *it);
+    }
+    return ret;
+}
+
+const DescriptionIndex::Header* DescriptionIndex::header() const
+{
+    return reinterpret_cast<const Header*>(m_data);
+}
+
+const guint32* DescriptionIndex::names() const
+{
+    return reinterpret_cast<const guint32*>(m_data + sizeof(Header));
+}
+
+const DescriptionIndex::Word* DescriptionIndex::words() const
+{
+    return reinterpret_cast<const Word*>(names() + header()->nNames);
+}
+
+const guint32* DescriptionIndex::postings() const
+{
+    return reinterpret_cast<const guint32*>(words() + header()->nWords);
+}
+
+const char* DescriptionIndex::strings() const
+{
+    return reinterpret_cast<const char*>(postings() + header()->nPostings);
+}
@@ -0,0 +1,94 @@
+/* description-index.h
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DESCRIPTION_INDEX_H
+#define DESCRIPTION_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define DESCRIPTION_INDEX "/var/cache/PackageKit/aptcc/descriptions.idx"
+
+/**
+ * An inverted index from the words of the package names and of all
+ * their descriptions, in every language, to the package names.
+ *
+ * Words are the runs of non-space characters, lowercased, so any string
+ * without spaces found in a name or a description is part of one word.
+ * The index is built for one state of the package lists and of the dpkg
+ * status, and is ignored once either changes.
+ */
+class DescriptionIndex
+{
+public:
+    DescriptionIndex();
+    ~DescriptionIndex();
+
+    /**
+      * Maps the index if it was built for the current package lists
+      */
+    bool open();
+
+    /**
+      * Returns the position of the package name in the index, or -1 if
+      * the package was not indexed
+      */
+    int lookup(const char *name) const;
+
+    /**
+      * Marks the packages having words that contain each of the
+      * lowercase strings, by the position returned by lookup()
+      */
+    void find(const vector<string> &literals, vector<bool> &candidates) const;
+
+    /**
+      * Builds the index in a thread, unless it's already being built
+      */
+    static void buildInBackground();
+
+    /**
+      * Stops and waits for the thread building the index
+      */
+    static void stopBackground();
+
+private:
+    struct Header;
+    struct Word;
+
+    static gpointer buildThread(gpointer data);
+    static bool build();
+
+    const Header* header() const;
+    const guint32* names() const;
+    const Word* words() const;
+    const guint32* postings() const;
+    const char* strings() const;
+
+    const char *m_data;
+    size_t m_size;
+};
+
+#endif
@@ -0,0 +1,387 @@
+/* dpkg-file-index.cpp
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "dpkg-file-index.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include "apt-utils.h"
+
+#define DPKG_FILE_INDEX_MAGIC "PKFIDX1"
+
+/*
+ * The file starts with the header, followed by the package, path and
+ * basename tables and then by the NUL terminated strings they point to.
+ * It is only ever read on the machine that wrote it, so the native byte
+ * order is used.
+ */
+struct DpkgFileIndex::Header {
+    char magic[8];
+    gint64 infoMtime;
+    guint32 nPackages;
+    guint32 nPaths;
+    guint32 stringsSize;
+    guint32 reserved;
+};
+
+struct DpkgFileIndex::Package {
+    gint64 mtime;
+    guint32 name;
+    guint32 size;
+};
+
+struct DpkgFileIndex::Entry {
+    guint32 offset;
+    guint32 package;
+};
+
+typedef struct {
+    gint64 mtime;
+    guint32 size;
+    string name;
+} ListFile;
+
+/**
+ * Orders the entries by the string they point to, and then by package
+ */
+class EntryLess
+{
+public:
+    EntryLess(const char *strings) : m_strings(strings) {}
+
+    template<class E>
+    bool operator()(const E &a, const E &b) const {
+        int ret = strcmp(m_strings + a.offset, m_strings + b.offset);
+        return ret < 0 || (ret == 0 && a.package < b.package);
+    }
+
+    template<class E>
+    bool operator()(const E &a, const char *key) const {
+        return strcmp(m_strings + a.offset, key) < 0;
+    }
+
+private:
+    const char *m_strings;
+};
+
+static gint64 stat_mtime(const struct stat &buf)
+{
+    return (gint64) buf.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + buf.st_mtim.tv_nsec;
+}
+
+DpkgFileIndex::DpkgFileIndex() :
+    m_data(0),
+    m_size(0),
+    m_mapped(false)
+{
+}
+
+DpkgFileIndex::~DpkgFileIndex()
+{
+    unmap();
+}
+
+bool DpkgFileIndex::open()
+{
+    struct stat infoStat;
+    if (stat(DPKG_INFO_DIR, &infoStat) != 0) {
+        g_debug("Error opening %s", DPKG_INFO_DIR);
+        return false;
+    }
+
+    // dpkg renames the .list files into place, so the directory
+    // changes whenever one of them does
+    gint64 infoMtime = stat_mtime(infoStat);
+    if (map() && header()->infoMtime == infoMtime) {
+        return true;
+    }
+
+    return update(infoMtime);
+}
+
+bool DpkgFileIndex::map()
+{
+    unmap();
+
+    int fd = ::open(DPKG_FILE_INDEX, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat buf;
+    if (fstat(fd, &buf) != 0 || (size_t) buf.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const char*>(data);
+    m_size = buf.st_size;
+    m_mapped = true;
+
+    // Check the file was completely written by this version
+    const Header *head = header();
+    size_t size = sizeof(Header) +
+            head->nPackages * sizeof(Package) +
+            head->nPaths * 2 * sizeof(Entry) +
+            head->stringsSize;
+    if (memcmp(head->magic, DPKG_FILE_INDEX_MAGIC, sizeof(head->magic)) != 0 ||
+            size != m_size ||
+            head->stringsSize == 0 ||
+            strings()[head->stringsSize - 1] != '\0') {
+        g_debug("Ignoring invalid file index");
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+void DpkgFileIndex::unmap()
+{
+    if (m_mapped) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = 0;
+    m_size = 0;
+    m_mapped = false;
+    m_buffer.clear();
+}
+
+bool DpkgFileIndex::update(gint64 infoMtime)
+{
+    DIR *dp;
+    struct dirent *dirp;
+    if (!(dp = opendir(DPKG_INFO_DIR))) {
+        g_debug("Error opening %s", DPKG_INFO_DIR);
+        return false;
+    }
+
+    std::vector<ListFile> lists;
+    while ((dirp = readdir(dp)) != NULL) {
+        if (!ends_with(dirp->d_name, ".list")) {
+            continue;
+        }
+
+        struct stat buf;
+        string file = string(DPKG_INFO_DIR) + dirp->d_name;
+        if (stat(file.c_str(), &buf) != 0) {
+            continue;
+        }
+
+        ListFile list;
+        list.mtime = stat_mtime(buf);
+        list.size = buf.st_size;
+        list.name = dirp->d_name;
+        list.name.erase(list.name.size() - 5);
+        lists.push_back(list);
+    }
+    closedir(dp);
+
+    // Find which packages of the old index can be kept as they are
+    std::map<string, guint32> oldPackages;
+    std::vector<std::vector<guint32> > oldPaths;
+    if (m_data) {
+        const Header *head = header();
+        for (guint32 i = 0; i < head->nPackages; ++i) {
+            oldPackages[strings() + packages()[i].name] = i;
+        }
+        oldPaths.resize(head->nPackages);
+        for (guint32 i = 0; i < head->nPaths; ++i) {
+            oldPaths[paths()[i].package].push_back(paths()[i].offset);
+        }
+    }
+
+    string pool;
+    std::vector<Package> newPackages;
+    std::vector<Entry> newPaths;
+    guint32 reused = 0;
+    for (std::vector<ListFile>::const_iterator it = lists.begin(); it != lists.end(); ++it) {
+        Package pkg;
+        pkg.mtime = it->mtime;
+        pkg.size = it->size;
+        pkg.name = pool.size();
+        pool.append(it->name.c_str(), it->name.size() + 1);
+
+        Entry entry;
+        entry.package = newPackages.size();
+        newPackages.push_back(pkg);
+
+        std::map<string, guint32>::const_iterator old = oldPackages.find(it->name);
+        if (old != oldPackages.end() &&
+                packages()[old->second].mtime == it->mtime &&
+                packages()[old->second].size == it->size) {
+            const std::vector<guint32> &strs = oldPaths[old->second];
+            for (std::vector<guint32>::const_iterator str = strs.begin(); str != strs.end(); ++str) {
+                entry.offset = pool.size();
+                pool.append(strings() + *str);
+                pool.push_back('\0');
+                newPaths.push_back(entry);
+            }
+            ++reused;
+            continue;
+        }
+
+        string line;
+        string file = string(DPKG_INFO_DIR) + it->name + ".list";
+        std::ifstream in(file.c_str());
+        while (getline(in, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            entry.offset = pool.size();
+            pool.append(line.c_str(), line.size() + 1);
+            newPaths.push_back(entry);
+        }
+    }
+    g_debug("Indexed %zu packages, %u unchanged", lists.size(), reused);
+
+    // The basename points into the middle of its path string
+    std::vector<Entry> newBasenames(newPaths);
+    for (std::vector<Entry>::iterator it = newBasenames.begin(); it != newBasenames.end(); ++it) {
+        const char *path = pool.c_str() + it->offset;
+        const char *slash = strrchr(path, '/');
+        if (slash) {
+            it->offset += slash + 1 - path;
+        }
+    }
+
+    // Keep an empty string so the pool is never empty
+    pool.push_back('\0');
+    std::sort(newPaths.begin(), newPaths.end(), EntryLess(pool.c_str()));
+    std::sort(newBasenames.begin(), newBasenames.end(), EntryLess(pool.c_str()));
+
+    Header head;
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, DPKG_FILE_INDEX_MAGIC, sizeof(head.magic));
+    head.infoMtime = infoMtime;
+    head.nPackages = newPackages.size();
+    head.nPaths = newPaths.size();
+    head.stringsSize = pool.size();
+
+    string buffer;
+    buffer.reserve(sizeof(head) +
+                   newPackages.size() * sizeof(Package) +
+                   newPaths.size() * 2 * sizeof(Entry) +
+                   pool.size());
+    buffer.append((const char*) &head, sizeof(head));
+    if (!newPackages.empty()) {
+        buffer.append((const char*) &newPackages[0], newPackages.size() * sizeof(Package));
+    }
+    if (!newPaths.empty()) {
+        buffer.append((const char*) &newPaths[0], newPaths.size() * sizeof(Entry));
+        buffer.append((const char*) &newBasenames[0], newBasenames.size() * sizeof(Entry));
+    }
+    buffer.append(pool);
+
+    // Not being able to save the index only makes the next search slower
+    GError *error = NULL;
+    gchar *dirname = g_path_get_dirname(DPKG_FILE_INDEX);
+    g_mkdir_with_parents(dirname, 0755);
+    g_free(dirname);
+    if (!g_file_set_contents(DPKG_FILE_INDEX, buffer.data(), buffer.size(), &error)) {
+        g_debug("Failed to save the file index: %s", error->message);
+        g_error_free(error);
+    }
+
+    unmap();
+    m_buffer.swap(buffer);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
+
+const DpkgFileIndex::Header* DpkgFileIndex::header() const
+{
+    return reinterpret_cast<const Header*>(m_data);
+}
+
+const DpkgFileIndex::Package* DpkgFileIndex::packages() const
+{
+    return reinterpret_cast<const Package*>(m_data + sizeof(Header));
+}
+
+const DpkgFileIndex::Entry* DpkgFileIndex::paths() const
+{
+    return reinterpret_cast<const Entry*>(packages() + header()->nPackages);
+}
+
+const DpkgFileIndex::Entry* DpkgFileIndex::basenames() const
+{
+    return paths() + header()->nPaths;
+}
+
+const char* DpkgFileIndex::strings() const
+{
+    return reinterpret_cast<const char*>(basenames() + header()->nPaths);
+}
+
+void DpkgFileIndex::findEntries(const Entry *entries, guint32 count, const char *key,
+                                std::set<string> &packages) const
+{
+    const Entry *end = entries + count;
+    const Entry *it = std::lower_bound(entries, end, key, EntryLess(strings()));
+    for (; it != end && strcmp(strings() + it->offset, key) == 0; ++it) {
+        packages.insert(strings() + this->packages()[it->package].name);
+    }
+}
+
+void DpkgFileIndex::findPath(const char *path, std::set<string> &packages) const
+{
+    findEntries(paths(), header()->nPaths, path, packages);
+}
+
+void DpkgFileIndex::findBasename(const char *name, std::set<string> &packages) const
+{
+    findEntries(basenames(), header()->nPaths, name, packages);
+}
+
+void DpkgFileIndex::findRegex(const regex_t *re, std::set<string> &packages) const
+{
+    const char *last = 0;
+    bool matched = false;
+    for (guint32 i = 0; i < header()->nPaths; ++i) {
+        const char *path = strings() + paths()[i].offset;
+
+        // Directories are listed by many packages, match them only once
+        if (last == 0 || strcmp(last, path) != 0) {
+            matched = regexec(re, path, 0, NULL, 0) == 0;
+            last = path;
+        }
+        if (matched) {
+            packages.insert(strings() + this->packages()[paths()[i].package].name);
+        }
+    }
+}
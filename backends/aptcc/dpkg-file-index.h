@@ -0,0 +1,95 @@
+/* dpkg-file-index.h
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DPKG_FILE_INDEX_H
+#define DPKG_FILE_INDEX_H
+
+#include <glib.h>
+#include <regex.h>
+#include <sys/types.h>
+
+#include <set>
+#include <string>
+
+using std::string;
+
+#define DPKG_INFO_DIR "/var/lib/dpkg/info/"
+#define DPKG_FILE_INDEX "/var/cache/PackageKit/aptcc/files.idx"
+
+/**
+ * An on-disk index of the files installed by each package, built from
+ * the dpkg .list files.
+ *
+ * The paths and the basenames are stored sorted, so looking them up is
+ * a binary search on the mapped file. Only the .list files that changed
+ * since the index was written are read again.
+ */
+class DpkgFileIndex
+{
+public:
+    DpkgFileIndex();
+    ~DpkgFileIndex();
+
+    /**
+      * Maps the index, updating it first if dpkg changed any package
+      * @returns false if neither the index nor the .list files can be read
+      */
+    bool open();
+
+    /**
+      * Adds the packages owning exactly this path
+      */
+    void findPath(const char *path, std::set<string> &packages) const;
+
+    /**
+      * Adds the packages owning a file or directory with this name
+      */
+    void findBasename(const char *name, std::set<string> &packages) const;
+
+    /**
+      * Adds the packages owning a path matched by the regular expression
+      */
+    void findRegex(const regex_t *re, std::set<string> &packages) const;
+
+private:
+    struct Header;
+    struct Package;
+    struct Entry;
+
+    bool map();
+    void unmap();
+    bool update(gint64 infoMtime);
+
+    const Header* header() const;
+    const Package* packages() const;
+    const Entry* paths() const;
+    const Entry* basenames() const;
+    const char* strings() const;
+    void findEntries(const Entry *entries, guint32 count, const char *key,
+                     std::set<string> &packages) const;
+
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+    string m_buffer;
+};
+
+#endif
@@ -23,6 +23,60 @@
 #include <regex.h>
 #include <gst/gst.h>
 
+#include <string.h>
+
+#include <algorithm>
+
+static const char *gstFields[] = {
+    "Gstreamer-Encoders: ",
+    "Gstreamer-Decoders: ",
+    "Gstreamer-Uri-Sources: ",
+    "Gstreamer-Uri-Sinks: ",
+    "Gstreamer-Elements: "
+};
+
+void GstIndex::add(const string &record, unsigned int pkgId)
+{
+    for (uint i = 0; i < G_N_ELEMENTS(gstFields); ++i) {
+        size_t found = record.find(gstFields[i]);
+        if (found == string::npos) {
+            continue;
+        }
+        found += strlen(gstFields[i]);
+        string field = record.substr(found, record.find('\n', found) - found);
+
+        // Index the caps structure names and element names, any other
+        // token only adds a candidate that matches() will discard
+        gchar **tokens = g_strsplit_set(field.c_str(), ",;", -1);
+        for (uint j = 0; tokens[j] != NULL; ++j) {
+            gchar *name = g_strstrip(tokens[j]);
+            if (name[0] == '\0' || strchr(name, '=') != NULL) {
+                continue;
+            }
+
+            // Drop caps features, "video/x-raw(memory:GLMemory)"
+            gchar *features = strchr(name, '(');
+            if (features != NULL) {
+                *features = '\0';
+            }
+
+            vector<unsigned int> &pkgIds = m_index[string(gstFields[i]) + name];
+            if (pkgIds.empty() || pkgIds.back() != pkgId) {
+                pkgIds.push_back(pkgId);
+            }
+        }
+        g_strfreev(tokens);
+    }
+}
+
+void GstIndex::find(const string &type, const string &name, vector<unsigned int> &pkgIds) const
+{
+    map<string, vector<unsigned int> >::const_iterator it = m_index.find(type + name);
+    if (it != m_index.end()) {
+        pkgIds.insert(pkgIds.end(), it->second.begin(), it->second.end());
+    }
+}
+
 GstMatcher::GstMatcher(gchar **values)
 {
     gst_init(NULL, NULL);
@@ -152,3 +206,17 @@ bool GstMatcher::hasMatches() const
 {
     return !m_matches.empty();
 }
+
+vector<unsigned int> GstMatcher::candidates(const GstIndex &index) const
+{
+    vector<unsigned int> pkgIds;
+    for (vector<Match>::const_iterator i = m_matches.begin(); i != m_matches.end(); ++i) {
+        index.find(i->type, i->data, pkgIds);
+        // ANY caps intersect with everything
+        index.find(i->type, "ANY", pkgIds);
+    }
+
+    sort(pkgIds.begin(), pkgIds.end());
+    pkgIds.erase(unique(pkgIds.begin(), pkgIds.end()), pkgIds.end());
+    return pkgIds;
+}
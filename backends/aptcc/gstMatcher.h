@@ -23,6 +23,7 @@
 
 #include <glib.h>
 
+#include <map>
 #include <vector>
 #include <string>
 
@@ -36,6 +37,23 @@ typedef struct {
     void    *caps;
 } Match;
 
+/**
+ * Maps each GStreamer record field and the caps types or element names
+ * it lists to the packages declaring them
+ */
+class GstIndex
+{
+public:
+    /**
+      * Adds the fields of the record, pkgId is the PkgIterator::Index()
+      */
+    void add(const string &record, unsigned int pkgId);
+    void find(const string &type, const string &name, vector<unsigned int> &pkgIds) const;
+
+private:
+    map<string, vector<unsigned int> > m_index;
+};
+
 class GstMatcher
 {
 public:
@@ -45,6 +63,12 @@ public:
     bool matches(string record);
     bool hasMatches() const;
 
+    /**
+      * Returns the sorted IDs of the packages that may match, the
+      * records still need to be checked with matches()
+      */
+    vector<unsigned int> candidates(const GstIndex &index) const;
+
 private:
     vector<Match> m_matches;
 };
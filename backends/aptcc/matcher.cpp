@@ -21,7 +21,9 @@
  */
 
 #include "matcher.h"
+#include <glib.h>
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 
 Matcher::Matcher(const string &matchers) :
@@ -88,6 +90,27 @@ bool Matcher::matchesFile(const string &s, map<int, bool> &matchers_used)
     return m_matches.size() == matchers_used.size();
 }
 
+vector<string> Matcher::literals() const
+{
+    vector<string> ret;
+    for (vector<string>::const_iterator i = m_patterns.begin();
+         i != m_patterns.end(); ++i) {
+        bool literal = true;
+        string lower;
+        for (string::const_iterator c = i->begin(); c != i->end(); ++c) {
+            if (!g_ascii_isgraph(*c) || strchr(".[]()*+?{}|^$\\", *c) != NULL) {
+                literal = false;
+                break;
+            }
+            lower += g_ascii_tolower(*c);
+        }
+        if (literal) {
+            ret.push_back(lower);
+        }
+    }
+    return ret;
+}
+
 bool Matcher::parse_pattern(string::const_iterator &start,
                             const std::string::const_iterator &end)
 {
@@ -110,6 +133,7 @@ bool Matcher::parse_pattern(string::const_iterator &start,
         regex_t pattern_nogroup;
         if (do_compile(subString, pattern_nogroup, REG_ICASE|REG_EXTENDED|REG_NOSUB)) {
             m_matches.push_back(pattern_nogroup);
+            m_patterns.push_back(subString);
         } else {
             regfree(&pattern_nogroup);
             m_error = string("Regex compilation error");
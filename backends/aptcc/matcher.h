@@ -40,6 +40,12 @@ public:
     bool matchesFile(const string &s, map<int, bool> &matchers_used);
     bool hasError() const;
 
+    /**
+      * Returns the patterns without any regex or non-ASCII character,
+      * lowercased, as every matching string contains all of them
+      */
+    vector<string> literals() const;
+
 private:
     bool m_hasError;
     string m_error;
@@ -50,6 +56,7 @@ private:
     string parse_literal_string_tail(string::const_iterator &start,
                                      const string::const_iterator end);
     vector<regex_t> m_matches;
+    vector<string> m_patterns;
 };
 
 #endif
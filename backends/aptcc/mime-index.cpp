@@ -0,0 +1,211 @@
+/* mime-index.cpp
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "mime-index.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+
+#include <fstream>
+
+#include "apt-utils.h"
+
+// MIME type to a GPtrArray of package names, guarded by indexLock
+static GMutex indexLock;
+static GHashTable *mimeIndex = NULL;
+static gint64 mimeIndexMtime = 0;
+
+bool MimeIndex::findPackages(gchar **mimeTypes, std::set<string> &packages)
+{
+    bool ret = true;
+
+    g_mutex_lock(&indexLock);
+
+    // dpkg renames the desktop files into place, so the directory
+    // changes whenever one of them does
+    gint64 mtime = utilFileMtime(APP_INSTALL_DESKTOP_DIR);
+    if (mtime == 0) {
+        ret = false;
+    } else if (mimeIndex == NULL || mimeIndexMtime != mtime) {
+        if (!load(mtime)) {
+            ret = build(mtime);
+            if (ret) {
+                save(mtime);
+            }
+        }
+    }
+
+    for (guint i = 0; ret && mimeTypes[i] != NULL; ++i) {
+        GPtrArray *array = (GPtrArray *) g_hash_table_lookup(mimeIndex, mimeTypes[i]);
+        if (array == NULL) {
+            continue;
+        }
+        for (guint j = 0; j < array->len; ++j) {
+            packages.insert((const gchar *) g_ptr_array_index(array, j));
+        }
+    }
+
+    g_mutex_unlock(&indexLock);
+
+    return ret;
+}
+
+void MimeIndex::add(const string &mimeType, const string &package)
+{
+    GPtrArray *array = (GPtrArray *) g_hash_table_lookup(mimeIndex, mimeType.c_str());
+    if (array == NULL) {
+        array = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(mimeIndex, g_strdup(mimeType.c_str()), array);
+    }
+
+    for (guint i = 0; i < array->len; ++i) {
+        if (package == (const gchar *) g_ptr_array_index(array, i)) {
+            return;
+        }
+    }
+    g_ptr_array_add(array, g_strdup(package.c_str()));
+}
+
+/**
+ * Reads the index saved by save(), if it was built from the same
+ * app-install directory
+ */
+bool MimeIndex::load(gint64 mtime)
+{
+    gchar *data;
+    if (!g_file_get_contents(MIME_INDEX, &data, NULL, NULL)) {
+        return false;
+    }
+
+    gchar **lines = g_strsplit(data, "\n", -1);
+    g_free(data);
+    if (lines[0] == NULL || g_ascii_strtoll(lines[0], NULL, 10) != mtime) {
+        g_strfreev(lines);
+        return false;
+    }
+
+    if (mimeIndex) {
+        g_hash_table_unref(mimeIndex);
+    }
+    mimeIndex = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, (GDestroyNotify) g_ptr_array_unref);
+    mimeIndexMtime = mtime;
+
+    for (guint i = 1; lines[i] != NULL; ++i) {
+        gchar **split = g_strsplit(lines[i], "\t", -1);
+        for (guint j = 1; split[0] != NULL && split[j] != NULL; ++j) {
+            add(split[0], split[j]);
+        }
+        g_strfreev(split);
+    }
+    g_strfreev(lines);
+
+    return true;
+}
+
+/**
+ * Reads the MimeType and X-AppInstall-Package keys of every
+ * app-install desktop file
+ */
+bool MimeIndex::build(gint64 mtime)
+{
+    DIR *dp;
+    struct dirent *dirp;
+    if (!(dp = opendir(APP_INSTALL_DESKTOP_DIR))) {
+        g_debug("Error opening %s", APP_INSTALL_DESKTOP_DIR);
+        return false;
+    }
+
+    if (mimeIndex) {
+        g_hash_table_unref(mimeIndex);
+    }
+    mimeIndex = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, (GDestroyNotify) g_ptr_array_unref);
+    mimeIndexMtime = mtime;
+
+    string line;
+    while ((dirp = readdir(dp)) != NULL) {
+        if (!ends_with(dirp->d_name, ".desktop")) {
+            continue;
+        }
+
+        string f = APP_INSTALL_DESKTOP_DIR + string(dirp->d_name);
+        ifstream in(f.c_str());
+        string mimeTypes;
+        string package;
+        while (getline(in, line)) {
+            if (starts_with(line, "MimeType=")) {
+                mimeTypes = line.substr(9);
+            } else if (starts_with(line, "X-AppInstall-Package=")) {
+                package = line.substr(21);
+            }
+        }
+        if (mimeTypes.empty() || package.empty()) {
+            continue;
+        }
+
+        gchar **split = g_strsplit(mimeTypes.c_str(), ";", -1);
+        for (guint i = 0; split[i] != NULL; ++i) {
+            if (split[i][0] != '\0') {
+                add(split[i], package);
+            }
+        }
+        g_strfreev(split);
+    }
+    closedir(dp);
+
+    g_debug("Indexed %u MIME types", g_hash_table_size(mimeIndex));
+    return true;
+}
+
+/**
+ * Saves the index as one line per MIME type, followed by its packages
+ */
+void MimeIndex::save(gint64 mtime)
+{
+    GString *data = g_string_new(NULL);
+    g_string_append_printf(data, "%" G_GINT64_FORMAT "\n", mtime);
+
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    g_hash_table_iter_init(&iter, mimeIndex);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *array = (GPtrArray *) value;
+        g_string_append(data, (const gchar *) key);
+        for (guint i = 0; i < array->len; ++i) {
+            g_string_append_c(data, '\t');
+            g_string_append(data, (const gchar *) g_ptr_array_index(array, i));
+        }
+        g_string_append_c(data, '\n');
+    }
+
+    // Not being able to save the index only makes the next start slower
+    GError *error = NULL;
+    gchar *dirname = g_path_get_dirname(MIME_INDEX);
+    g_mkdir_with_parents(dirname, 0755);
+    g_free(dirname);
+    if (!g_file_set_contents(MIME_INDEX, data->str, data->len, &error)) {
+        g_debug("Failed to save the MIME index: %s", error->message);
+        g_error_free(error);
+    }
+    g_string_free(data, TRUE);
+}
@@ -0,0 +1,58 @@
+/* mime-index.h
+ *
+ * Copyright (c) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MIME_INDEX_H
+#define MIME_INDEX_H
+
+#include <glib.h>
+
+#include <set>
+#include <string>
+
+using std::string;
+
+#define APP_INSTALL_DESKTOP_DIR "/usr/share/app-install/desktop/"
+#define MIME_INDEX "/var/cache/PackageKit/aptcc/mime.idx"
+
+/**
+ * Maps MIME types to the packages shipping an application that handles
+ * them, as listed by the app-install desktop files.
+ *
+ * The index is kept in memory between jobs and saved to disk, and is
+ * only built again when the app-install directory changes.
+ */
+class MimeIndex
+{
+public:
+    /**
+      * Adds the packages that can handle one of the MIME types
+      * @returns false if the app-install data can't be read
+      */
+    static bool findPackages(gchar **mimeTypes, std::set<string> &packages);
+
+private:
+    static bool load(gint64 mtime);
+    static bool build(gint64 mtime);
+    static void save(gint64 mtime);
+    static void add(const string &mimeType, const string &package);
+};
+
+#endif
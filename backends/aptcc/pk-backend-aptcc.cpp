@@ -30,6 +30,7 @@
 
 #include "apt-intf.h"
 #include "AptCacheFile.h"
+#include "description-index.h"
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "apt-sourceslist.h"
@@ -59,8 +60,16 @@ const gchar* pk_backend_get_author(PkBackend *backend)
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-	// we need to set this to TRUE as soon as the parallelization work is completed!
-	return FALSE;
+	return TRUE;
+}
+
+/**
+ * pk_backend_dpkg_status_changed_cb:
+ */
+static void pk_backend_dpkg_status_changed_cb(PkBackend *backend, gpointer data)
+{
+    g_debug("dpkg status changed, dropping the shared package cache");
+    AptCacheFile::invalidateShared();
 }
 
 /**
@@ -89,6 +98,11 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
         g_debug("ERROR initializing backend system");
     }
 
+    // The lists directory and the sources are checked when the
+    // shared package cache is acquired, as only one file can be watched
+    string status = _config->FindFile("Dir::State::status");
+    pk_backend_watch_file(backend, status.c_str(), pk_backend_dpkg_status_changed_cb, NULL);
+
     spawn = pk_backend_spawn_new(conf);
 //     pk_backend_spawn_set_job(spawn, backend);
     pk_backend_spawn_set_name(spawn, "aptcc");
@@ -100,6 +114,8 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APTcc being destroyed");
+    DescriptionIndex::stopBackground();
+    AptCacheFile::destroyShared();
 }
 
 /**
@@ -227,6 +243,7 @@ static void backend_depends_on_or_requires_thread(PkBackendJob *job, GVariant *p
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -305,6 +322,7 @@ static void backend_get_files_thread(PkBackendJob *job, GVariant *params, gpoint
                   &package_ids);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -359,6 +377,7 @@ static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpoi
                   &package_ids);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug ("Failed to create apt cache");
         return;
@@ -405,6 +424,7 @@ static void backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpoi
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -435,6 +455,7 @@ static void backend_what_provides_thread(PkBackendJob *job, GVariant *params, gp
     gchar **values;
     bool error = false;
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
 
     g_variant_get(params, "(t^a&s)",
                   &filters,
@@ -487,6 +508,7 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -599,6 +621,7 @@ static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params,
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -637,6 +660,7 @@ static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpoin
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -661,6 +685,7 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
     gchar **search;
     PkBitfield filters;
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
 
     g_variant_get(params, "(t^a&s)",
                   &filters,
@@ -702,6 +727,7 @@ static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gp
                   &search);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -736,6 +762,7 @@ static void backend_search_package_thread(PkBackendJob *job, GVariant *params, g
     search = g_strjoinv("|", values);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         g_free(search);
@@ -834,6 +861,7 @@ static void backend_manage_packages_thread(PkBackendJob *job, GVariant *params,
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -976,6 +1004,7 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
     // generic
     PkRoleEnum role;
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
 
     role = pk_backend_job_get_role(job);
     if (role == PK_ROLE_ENUM_GET_REPO_LIST) {
@@ -1133,6 +1162,7 @@ static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpo
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
+    AptJobLocale locale(job);
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
         return;
@@ -50,17 +50,28 @@ typedef struct {
 	HySack		 sack;
 	gboolean	 valid;
 	gchar		*key;
+	gint		 refcount;
+	GMutex		 query_mutex;	/* held by the job using the sack */
+	GHashTable	*source_ids;	/* of the loaded remote sources */
 } HifSackCacheItem;
 
 typedef struct {
 	HifContext	*context;
 	GHashTable	*sack_cache;	/* of HifSackCacheItem */
 	GMutex		 sack_mutex;
+	GMutex		 sack_build_mutex;
+	GMutex		 job_mutex;
+	GCond		 job_cond;
+	guint		 job_readers;
+	guint		 job_writers_waiting;
+	gboolean	 job_writer;
+	GThreadPool	*rebuild_pool;
 	HifRepos	*repos;
 	GTimer		*repos_timer;
 } PkBackendHifPrivate;
 
 typedef struct {
+	GPtrArray	*sacks;		/* of HifSackCacheItem */
 	GPtrArray	*sources;
 	HifState	*state;
 	PkBackend	*backend;
@@ -92,7 +103,7 @@ pk_backend_get_author (PkBackend *backend)
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-	return FALSE;
+	return TRUE;
 }
 
 /**
@@ -119,23 +130,69 @@ pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
 	g_mutex_unlock (&priv->sack_mutex);
 }
 
+/**
+ * pk_backend_sack_cache_invalidate_source:
+ *
+ * Only marks the sacks that loaded the source as invalid, or the ones
+ * with any remote source if @source_id is %NULL.
+ **/
+static void
+pk_backend_sack_cache_invalidate_source (PkBackend *backend,
+					 const gchar *source_id,
+					 const gchar *why)
+{
+	GList *l;
+	HifSackCacheItem *cache_item;
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+	_cleanup_list_free_ GList *values = NULL;
+
+	g_mutex_lock (&priv->sack_mutex);
+	values = g_hash_table_get_values (priv->sack_cache);
+	for (l = values; l != NULL; l = l->next) {
+		cache_item = l->data;
+		if (!cache_item->valid || cache_item->source_ids == NULL)
+			continue;
+		if (source_id != NULL &&
+		    !g_hash_table_contains (cache_item->source_ids, source_id))
+			continue;
+		g_debug ("invalidating %s as %s", cache_item->key, why);
+		cache_item->valid = FALSE;
+	}
+	g_mutex_unlock (&priv->sack_mutex);
+}
+
 /**
  * pk_backend_hif_repos_changed_cb:
  **/
 static void
 pk_backend_hif_repos_changed_cb (HifRepos *self, PkBackend *backend)
 {
-	pk_backend_sack_cache_invalidate (backend, "yum.repos.d changed");
+	pk_backend_sack_cache_invalidate_source (backend, NULL, "yum.repos.d changed");
 	pk_backend_repo_list_changed (backend);
 }
 
 /**
- * hif_sack_cache_item_free:
+ * hif_sack_cache_item_ref:
+ */
+static HifSackCacheItem *
+hif_sack_cache_item_ref (HifSackCacheItem *cache_item)
+{
+	g_atomic_int_inc (&cache_item->refcount);
+	return cache_item;
+}
+
+/**
+ * hif_sack_cache_item_unref:
  */
 static void
-hif_sack_cache_item_free (HifSackCacheItem *cache_item)
+hif_sack_cache_item_unref (HifSackCacheItem *cache_item)
 {
+	if (!g_atomic_int_dec_and_test (&cache_item->refcount))
+		return;
 	hy_sack_free (cache_item->sack);
+	g_mutex_clear (&cache_item->query_mutex);
+	if (cache_item->source_ids != NULL)
+		g_hash_table_unref (cache_item->source_ids);
 	g_free (cache_item->key);
 	g_slice_free (HifSackCacheItem, cache_item);
 }
@@ -217,12 +274,17 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	 * - this deals with deallocating the sack when the backend is unloaded
 	 * - all the cached sacks are dropped on any transaction that can
 	 *   modify state or if the repos or rpmdb are changed
+	 * - the jobs using a sack keep a reference, so a dropped sack is
+	 *   only freed when the last of them has finished
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	g_mutex_init (&priv->sack_build_mutex);
+	g_mutex_init (&priv->job_mutex);
+	g_cond_init (&priv->job_cond);
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
-						  (GDestroyNotify) hif_sack_cache_item_free);
+						  (GDestroyNotify) hif_sack_cache_item_unref);
 
 	/* set defaults */
 	priv->context = hif_context_new ();
@@ -280,11 +342,18 @@ void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* wait for the sack that is being loaded */
+	if (priv->rebuild_pool != NULL)
+		g_thread_pool_free (priv->rebuild_pool, FALSE, TRUE);
 	if (priv->context != NULL)
 		g_object_unref (priv->context);
 	g_timer_destroy (priv->repos_timer);
 	g_object_unref (priv->repos);
 	g_mutex_clear (&priv->sack_mutex);
+	g_mutex_clear (&priv->sack_build_mutex);
+	g_mutex_clear (&priv->job_mutex);
+	g_cond_clear (&priv->job_cond);
 	g_hash_table_unref (priv->sack_cache);
 	g_free (priv);
 }
@@ -382,6 +451,7 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 	PkBackendHifJobData *job_data;
 	job_data = g_new0 (PkBackendHifJobData, 1);
 	job_data->backend = backend;
+	job_data->sacks = g_ptr_array_new_with_free_func ((GDestroyNotify) hif_sack_cache_item_unref);
 	pk_backend_job_set_user_data (job, job_data);
 
 	/* HifState */
@@ -423,79 +493,176 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 		g_ptr_array_unref (job_data->sources);
 	if (job_data->goal != NULL)
 		hy_goal_free (job_data->goal);
+	g_ptr_array_unref (job_data->sacks);
 	g_free (job_data);
 	pk_backend_job_set_user_data (job, NULL);
 }
 
 /**
- * pk_backend_ensure_sources:
+ * pk_backend_role_is_read_only:
  */
 static gboolean
-pk_backend_ensure_sources (PkBackendHifJobData *job_data, GError **error)
+pk_backend_role_is_read_only (PkRoleEnum role)
 {
-	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
-
-	/* already set */
-	if (job_data->sources != NULL)
+	switch (role) {
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
 		return TRUE;
-
-	/* set the list of repos */
-	job_data->sources = hif_repos_get_sources (priv->repos, error);
-	if (job_data->sources == NULL)
+	default:
 		return FALSE;
-	return TRUE;
+	}
 }
 
 /**
- * hif_utils_add_remote:
+ * pk_backend_lock_shared:
+ *
+ * Waits for the job lock to be shared with the other read-only jobs.
+ * A waiting writer stops new readers, so a stream of searches cannot
+ * keep an install from running.
+ **/
+static void
+pk_backend_lock_shared (PkBackendHifPrivate *priv)
+{
+	g_mutex_lock (&priv->job_mutex);
+	while (priv->job_writer || priv->job_writers_waiting > 0)
+		g_cond_wait (&priv->job_cond, &priv->job_mutex);
+	priv->job_readers++;
+	g_mutex_unlock (&priv->job_mutex);
+}
+
+/**
+ * pk_backend_unlock_shared:
  */
-static gboolean
-hif_utils_add_remote (PkBackendJob *job,
-		      HySack sack,
-		      HifSackAddFlags flags,
-		      HifState *state,
-		      GError **error)
+static void
+pk_backend_unlock_shared (PkBackendHifPrivate *priv)
 {
-	gboolean ret;
-	HifState *state_local;
+	g_mutex_lock (&priv->job_mutex);
+	if (--priv->job_readers == 0)
+		g_cond_broadcast (&priv->job_cond);
+	g_mutex_unlock (&priv->job_mutex);
+}
+
+/**
+ * pk_backend_lock_exclusive:
+ */
+static void
+pk_backend_lock_exclusive (PkBackendHifPrivate *priv)
+{
+	g_mutex_lock (&priv->job_mutex);
+	priv->job_writers_waiting++;
+	while (priv->job_writer || priv->job_readers > 0)
+		g_cond_wait (&priv->job_cond, &priv->job_mutex);
+	priv->job_writers_waiting--;
+	priv->job_writer = TRUE;
+	g_mutex_unlock (&priv->job_mutex);
+}
+
+/**
+ * pk_backend_unlock_exclusive:
+ */
+static void
+pk_backend_unlock_exclusive (PkBackendHifPrivate *priv)
+{
+	g_mutex_lock (&priv->job_mutex);
+	priv->job_writer = FALSE;
+	g_cond_broadcast (&priv->job_cond);
+	g_mutex_unlock (&priv->job_mutex);
+}
+
+/**
+ * pk_backend_job_release_sacks:
+ *
+ * Lets the next job query the sacks this job was using.
+ **/
+static void
+pk_backend_job_release_sacks (PkBackendHifJobData *job_data)
+{
+	HifSackCacheItem *cache_item;
+	guint i;
+
+	/* the goal still points into the sack */
+	if (job_data->goal != NULL) {
+		hy_goal_free (job_data->goal);
+		job_data->goal = NULL;
+	}
+	for (i = 0; i < job_data->sacks->len; i++) {
+		cache_item = g_ptr_array_index (job_data->sacks, i);
+		g_mutex_unlock (&cache_item->query_mutex);
+	}
+}
+
+/**
+ * pk_backend_job_thread:
+ *
+ * Runs the thread of the job while holding the job lock. The roles that
+ * only query the cached sacks share it, all the others run on their own.
+ * Readers of the same sack still take turns, see hif_utils_job_use_sack().
+ **/
+static void
+pk_backend_job_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBackendJobThreadFunc func = (PkBackendJobThreadFunc) user_data;
 	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
 
-	/* set state */
-	ret = hif_state_set_steps (state, error,
-				   2, /* load files */
-				   98, /* add sources */
-				   -1);
-	if (!ret)
-		return FALSE;
+	if (pk_backend_role_is_read_only (pk_backend_job_get_role (job))) {
+		pk_backend_lock_shared (priv);
+		func (job, params, NULL);
+		pk_backend_job_release_sacks (job_data);
+		pk_backend_unlock_shared (priv);
+		return;
+	}
 
-	/* set the list of repos */
-	if (!pk_backend_ensure_sources (job_data, error))
-		return FALSE;
+	pk_backend_lock_exclusive (priv);
+	pk_backend_job_set_locked (job, TRUE);
+	func (job, params, NULL);
+	pk_backend_job_release_sacks (job_data);
+	pk_backend_job_set_locked (job, FALSE);
+	pk_backend_unlock_exclusive (priv);
+}
 
-	/* done */
-	if (!hif_state_done (state, error))
-		return FALSE;
+/**
+ * pk_backend_thread_create:
+ */
+static void
+pk_backend_thread_create (PkBackendJob *job, PkBackendJobThreadFunc func)
+{
+	pk_backend_job_thread_create (job, pk_backend_job_thread, (gpointer) func, NULL);
+}
 
-	/* add each repo */
-	state_local = hif_state_get_child (state);
-	ret = hif_sack_add_sources (sack,
-				    job_data->sources,
-				    pk_backend_job_get_cache_age (job),
-				    flags,
-				    state_local,
-				    error);
-	if (!ret)
-		return FALSE;
+/**
+ * pk_backend_ensure_sources:
+ */
+static gboolean
+pk_backend_ensure_sources (PkBackendHifJobData *job_data, GError **error)
+{
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
 
-	/* done */
-	if (!hif_state_done (state, error))
+	/* already set */
+	if (job_data->sources != NULL)
+		return TRUE;
+
+	/* set the list of repos, which may be reloaded for this job */
+	g_mutex_lock (&priv->sack_mutex);
+	job_data->sources = hif_repos_get_sources (priv->repos, error);
+	g_mutex_unlock (&priv->sack_mutex);
+	if (job_data->sources == NULL)
 		return FALSE;
 	return TRUE;
 }
 
 typedef enum {
-	HIF_CREATE_SACK_FLAG_NONE,
-	HIF_CREATE_SACK_FLAG_USE_CACHE,
+	HIF_CREATE_SACK_FLAG_NONE		= 0,
+	HIF_CREATE_SACK_FLAG_USE_CACHE		= 1 << 0,
+	HIF_CREATE_SACK_FLAG_FILELISTS		= 1 << 1,
 	HIF_CREATE_SACK_FLAG_LAST
 } HifCreateSackFlags;
 
@@ -546,79 +713,127 @@ hif_utils_real_path (const gchar *path)
 }
 
 /**
- * hif_utils_create_sack_for_filters:
- */
+ * hif_utils_lookup_cached_sack:
+ *
+ * Finds a valid sack in the cache for @flags, or for the same @flags with
+ * the filelists as they are a superset. The caller holds sack_mutex.
+ **/
+static HifSackCacheItem *
+hif_utils_lookup_cached_sack (PkBackendHifPrivate *priv, HifSackAddFlags flags)
+{
+	HifSackCacheItem *cache_item;
+	guint i;
+	HifSackAddFlags try_flags[] = { flags,
+					flags | HIF_SACK_ADD_FLAG_FILELISTS };
+
+	for (i = 0; i < G_N_ELEMENTS (try_flags); i++) {
+		_cleanup_free_ gchar *cache_key = NULL;
+		if (i > 0 && try_flags[i] == flags)
+			break;
+		cache_key = hif_utils_create_cache_key (try_flags[i]);
+		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+		if (cache_item == NULL || cache_item->sack == NULL)
+			continue;
+		if (cache_item->valid)
+			return cache_item;
+
+		/* we have to do this now rather than rely on the
+		 * callback of the hash table */
+		g_hash_table_remove (priv->sack_cache, cache_key);
+	}
+	return NULL;
+}
+
+/**
+ * hif_utils_get_cached_sack:
+ *
+ * Returns a reference to a valid sack from the cache.
+ **/
+static HifSackCacheItem *
+hif_utils_get_cached_sack (PkBackendHifPrivate *priv, HifSackAddFlags flags)
+{
+	HifSackCacheItem *cache_item;
+
+	g_mutex_lock (&priv->sack_mutex);
+	cache_item = hif_utils_lookup_cached_sack (priv, flags);
+	if (cache_item != NULL) {
+		g_debug ("using cached sack %s", cache_item->key);
+		hif_sack_cache_item_ref (cache_item);
+	}
+	g_mutex_unlock (&priv->sack_mutex);
+	return cache_item;
+}
+
+/**
+ * hif_utils_job_use_sack:
+ *
+ * Takes the reference to the sack and waits until no other job queries it.
+ * Any hawkey query or package accessor can rebuild the string and relation
+ * hashes or use the scratch space of the libsolv pool, so the job keeps the
+ * sack to itself until it finishes.
+ **/
 static HySack
-hif_utils_create_sack_for_filters (PkBackendJob *job,
-				   PkBitfield filters,
-				   HifCreateSackFlags create_flags,
-				   HifState *state,
-				   GError **error)
+hif_utils_job_use_sack (PkBackendHifJobData *job_data, HifSackCacheItem *cache_item)
+{
+	g_mutex_lock (&cache_item->query_mutex);
+	g_ptr_array_add (job_data->sacks, cache_item);
+	return cache_item->sack;
+}
+
+/**
+ * hif_utils_prepare_sack:
+ *
+ * libsolv creates the provides index on first use, so do it once when
+ * the sack is loaded rather than in the first job to query it.
+ **/
+static void
+hif_utils_prepare_sack (HySack sack)
+{
+	HyPackageList pkglist;
+	HyQuery query;
+
+	query = hy_query_create (sack);
+	hy_query_filter_provides (query, HY_EQ, "rpm", NULL);
+	pkglist = hy_query_run (query);
+	hy_packagelist_free (pkglist);
+	hy_query_free (query);
+}
+
+/**
+ * hif_utils_build_sack:
+ *
+ * Loads the installed packages, and the enabled sources if the flags
+ * have HIF_SACK_ADD_FLAG_REMOTE, into a new sack and saves it in the
+ * cache. The caller holds sack_build_mutex and gets a reference.
+ **/
+static HifSackCacheItem *
+hif_utils_build_sack (PkBackend *backend,
+		      GPtrArray *sources,
+		      guint cache_age,
+		      HifSackAddFlags flags,
+		      HifState *state,
+		      GError **error)
 {
-	gboolean ret;
 	gint rc;
-	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_FILELISTS;
-	HifSackCacheItem *cache_item = NULL;
+	guint i;
+	HifSackCacheItem *cache_item;
+	HifSource *src;
 	HifState *state_local;
 	HySack sack = NULL;
-	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
-	_cleanup_free_ gchar *cache_key = NULL;
 	_cleanup_free_ gchar *install_root = NULL;
 	_cleanup_free_ gchar *solv_dir = NULL;
 
-	/* don't add if we're going to filter out anyway */
-	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
-		flags |= HIF_SACK_ADD_FLAG_REMOTE;
-
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
-		flags |= HIF_SACK_ADD_FLAG_UPDATEINFO;
-
-	/* media repos could disappear at any time */
-	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
-	    hif_repos_has_removable (priv->repos) &&
-	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
-		g_debug ("not reusing sack as media may have disappeared");
-		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-	g_timer_reset (priv->repos_timer);
-
-	/* if we've specified a specific cache-age then do not use the cache */
-	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
-	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
-		g_debug ("not reusing sack specific cache age requested");
-		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
-	}
-
-	/* do we have anything in the cache */
-	cache_key = hif_utils_create_cache_key (flags);
-	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0)
-		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
-	if (cache_item != NULL && cache_item->sack != NULL) {
-		if (cache_item->valid) {
-			ret = TRUE;
-			g_debug ("using cached sack %s", cache_key);
-			sack = cache_item->sack;
-			goto out;
-		} else {
-			/* we have to do this now rather than rely on the
-			 * callback of the hash table */
-			g_hash_table_remove (priv->sack_cache, cache_key);
-		}
-	}
-
 	/* update status */
 	hif_state_action_start (state, HIF_STATE_ACTION_QUERY, NULL);
 
 	/* set state */
 	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0) {
-		ret = hif_state_set_steps (state, error,
-					   8, /* add installed */
-					   92, /* add remote */
-					   -1);
-		if (!ret)
-			goto out;
+		if (!hif_state_set_steps (state, error,
+					  8, /* add installed */
+					  92, /* add remote */
+					  -1))
+			return NULL;
 	} else {
 		hif_state_set_number_steps (state, 1);
 	}
@@ -628,58 +843,162 @@ hif_utils_create_sack_for_filters (PkBackendJob *job,
 	install_root = hif_utils_real_path (hif_context_get_install_root (priv->context));
 	sack = hy_sack_create (solv_dir, NULL, install_root, HY_MAKE_CACHE_DIR);
 	if (sack == NULL) {
-		ret = hif_rc_to_gerror (hy_get_errno (), error);
+		hif_rc_to_gerror (hy_get_errno (), error);
 		g_prefix_error (error, "failed to create sack in %s for %s: ",
 				hif_context_get_solv_dir (priv->context),
 				hif_context_get_install_root (priv->context));
-		goto out;
+		return NULL;
 	}
 
 	/* add installed packages */
 	rc = hy_sack_load_system_repo (sack, NULL, HY_BUILD_CACHE);
-	ret = hif_rc_to_gerror (rc, error);
-	if (!ret) {
+	if (!hif_rc_to_gerror (rc, error)) {
 		g_prefix_error (error, "Failed to load system repo: ");
 		goto out;
 	}
 
 	/* done */
-	ret = hif_state_done (state, error);
-	if (!ret)
+	if (!hif_state_done (state, error))
 		goto out;
 
-	/* add remote packages */
+	/* add remote packages, the sources that did not change since they
+	 * were last loaded are read from their solv files */
 	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0) {
 		state_local = hif_state_get_child (state);
-		ret = hif_utils_add_remote (job, sack, flags,
-					    state_local, error);
-		if (!ret)
+		if (!hif_sack_add_sources (sack, sources, cache_age, flags,
+					   state_local, error))
 			goto out;
 
 		/* done */
-		ret = hif_state_done (state, error);
-		if (!ret)
+		if (!hif_state_done (state, error))
 			goto out;
 	}
 
 	/* creates repo for command line rpms */
 	hy_sack_create_cmdline_repo (sack);
+	hif_utils_prepare_sack (sack);
 
-	/* save in cache */
-	g_mutex_lock (&priv->sack_mutex);
-	cache_item = g_slice_new (HifSackCacheItem);
-	cache_item->key = g_strdup (cache_key);
+	/* remember the sources, so it is only loaded again when they change */
+	cache_item = g_slice_new0 (HifSackCacheItem);
+	cache_item->key = hif_utils_create_cache_key (flags);
 	cache_item->sack = sack;
 	cache_item->valid = TRUE;
+	cache_item->refcount = 1;
+	g_mutex_init (&cache_item->query_mutex);
+	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0) {
+		cache_item->source_ids = g_hash_table_new_full (g_str_hash,
+								g_str_equal,
+								g_free,
+								NULL);
+		for (i = 0; i < sources->len; i++) {
+			src = g_ptr_array_index (sources, i);
+			if (!hif_source_get_enabled (src))
+				continue;
+			g_hash_table_add (cache_item->source_ids,
+					  g_strdup (hif_source_get_id (src)));
+		}
+	}
+
+	/* save in cache */
+	g_mutex_lock (&priv->sack_mutex);
 	g_debug ("created cached sack %s", cache_item->key);
-	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
+
+	/* hawkey cannot add the filelists to a loaded sack, so the new
+	 * sack replaces the one without them for the same sources; jobs
+	 * still using the old sack keep their own reference */
+	if ((flags & HIF_SACK_ADD_FLAG_FILELISTS) > 0) {
+		_cleanup_free_ gchar *old_key = NULL;
+		old_key = hif_utils_create_cache_key (flags & ~HIF_SACK_ADD_FLAG_FILELISTS);
+		if (g_hash_table_remove (priv->sack_cache, old_key))
+			g_debug ("upgraded cached sack %s", old_key);
+	}
+	g_hash_table_insert (priv->sack_cache, g_strdup (cache_item->key), cache_item);
+	hif_sack_cache_item_ref (cache_item);
 	g_mutex_unlock (&priv->sack_mutex);
+	return cache_item;
 out:
-	if (!ret && sack != NULL) {
-		hy_sack_free (sack);
-		sack = NULL;
+	hy_sack_free (sack);
+	return NULL;
+}
+
+/**
+ * hif_utils_create_sack_for_filters:
+ */
+static HySack
+hif_utils_create_sack_for_filters (PkBackendJob *job,
+				   PkBitfield filters,
+				   HifCreateSackFlags create_flags,
+				   HifState *state,
+				   GError **error)
+{
+	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_NONE;
+	HifSackCacheItem *cache_item = NULL;
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+
+	/* only load the filelists when the role looks at files */
+	if ((create_flags & HIF_CREATE_SACK_FLAG_FILELISTS) > 0)
+		flags |= HIF_SACK_ADD_FLAG_FILELISTS;
+
+	/* don't add if we're going to filter out anyway */
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
+		flags |= HIF_SACK_ADD_FLAG_REMOTE;
+
+	/* only load updateinfo when required */
+	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
+		flags |= HIF_SACK_ADD_FLAG_UPDATEINFO;
+
+	/* media repos could disappear at any time */
+	g_mutex_lock (&priv->sack_mutex);
+	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
+	    hif_repos_has_removable (priv->repos) &&
+	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
+		g_debug ("not reusing sack as media may have disappeared");
+		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
+	}
+	g_timer_reset (priv->repos_timer);
+	g_mutex_unlock (&priv->sack_mutex);
+
+	/* if we've specified a specific cache-age then do not use the cache */
+	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    pk_backend_job_get_cache_age (job) != G_MAXUINT) {
+		g_debug ("not reusing sack specific cache age requested");
+		create_flags &= ~HIF_CREATE_SACK_FLAG_USE_CACHE;
 	}
-	return sack;
+
+	/* do we have anything in the cache */
+	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
+		cache_item = hif_utils_get_cached_sack (priv, flags);
+		if (cache_item != NULL)
+			return hif_utils_job_use_sack (job_data, cache_item);
+	}
+
+	/* only one job loads the metadata at a time, and it may have
+	 * created the sack we want while we were waiting */
+	g_mutex_lock (&priv->sack_build_mutex);
+	if ((create_flags & HIF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
+		cache_item = hif_utils_get_cached_sack (priv, flags);
+		if (cache_item != NULL)
+			goto out;
+	}
+
+	/* set the list of repos */
+	if ((flags & HIF_SACK_ADD_FLAG_REMOTE) > 0 &&
+	    !pk_backend_ensure_sources (job_data, error))
+		goto out;
+
+	cache_item = hif_utils_build_sack (backend,
+					   job_data->sources,
+					   pk_backend_job_get_cache_age (job),
+					   flags,
+					   state,
+					   error);
+out:
+	g_mutex_unlock (&priv->sack_build_mutex);
+	if (cache_item == NULL)
+		return NULL;
+	return hif_utils_job_use_sack (job_data, cache_item);
 }
 
 /**
@@ -827,6 +1146,8 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 {
 	gboolean ret;
 	gchar **search_tmp;
+	guint i;
+	HifCreateSackFlags create_flags = HIF_CREATE_SACK_FLAG_USE_CACHE;
 	HifDb *db;
 	HifState *state_local;
 	HifTransaction *transaction;
@@ -877,11 +1198,30 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		goto out;
 	}
 
+	/* only load the filelists when the query or the depsolve looks at files */
+	switch (pk_backend_job_get_role (job)) {
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_GET_UPDATES:
+		create_flags |= HIF_CREATE_SACK_FLAG_FILELISTS;
+		break;
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		for (i = 0; search[i] != NULL; i++) {
+			if (search[i][0] == '/')
+				create_flags |= HIF_CREATE_SACK_FLAG_FILELISTS;
+		}
+		break;
+	default:
+		break;
+	}
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) ||
+	    pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION))
+		create_flags |= HIF_CREATE_SACK_FLAG_FILELISTS;
+
 	/* get sack */
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  create_flags,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -1006,7 +1346,7 @@ pk_backend_get_packages (PkBackend *backend,
 			 PkBackendJob *job,
 			 PkBitfield filters)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1018,7 +1358,7 @@ pk_backend_resolve (PkBackend *backend,
 		    PkBitfield filters,
 		    gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1030,7 +1370,7 @@ pk_backend_search_names (PkBackend *backend,
 			 PkBitfield filters,
 			 gchar **values)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1042,7 +1382,7 @@ pk_backend_search_details (PkBackend *backend,
 			   PkBitfield filters,
 			   gchar **values)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1054,7 +1394,7 @@ pk_backend_search_files (PkBackend *backend,
 			 PkBitfield filters,
 			 gchar **values)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1066,7 +1406,7 @@ pk_backend_what_provides (PkBackend *backend,
 			  PkBitfield filters,
 			  gchar **values)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1077,7 +1417,7 @@ pk_backend_get_updates (PkBackend *backend,
 			PkBackendJob *job,
 			PkBitfield filters)
 {
-	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_search_thread);
 }
 
 /**
@@ -1181,7 +1521,7 @@ pk_backend_get_repo_list (PkBackend *backend,
 			  PkBackendJob *job,
 			  PkBitfield filters)
 {
-	pk_backend_job_thread_create (job, pk_backend_get_repo_list_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_get_repo_list_thread);
 }
 
 /**
@@ -1263,7 +1603,7 @@ pk_backend_repo_set_data (PkBackend *backend,
 			  const gchar *parameter,
 			  const gchar *value)
 {
-	pk_backend_job_thread_create (job, pk_backend_repo_set_data_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_repo_set_data_thread);
 }
 
 /**
@@ -1312,6 +1652,7 @@ pk_backend_get_mime_types (PkBackend *backend)
 static gboolean
 pk_backend_refresh_source (PkBackendJob *job,
 			   HifSource *src,
+			   gboolean *updated,
 			   HifState *state,
 			   GError **error)
 {
@@ -1367,6 +1708,8 @@ pk_backend_refresh_source (PkBackendJob *job,
 				g_propagate_error (error, error_local);
 				return FALSE;
 			}
+		} else {
+			*updated = TRUE;
 		}
 	}
 
@@ -1374,6 +1717,50 @@ pk_backend_refresh_source (PkBackendJob *job,
 	return hif_state_done (state, error);
 }
 
+/**
+ * pk_backend_sack_rebuild_cb:
+ *
+ * Loads the sack used by GetUpdates in the background, as that is what
+ * is usually asked for after a refresh. The filelists are included as the
+ * update depsolve needs them, and the searches without filters are also
+ * served from this sack as it is a superset of the one they would load.
+ **/
+static void
+pk_backend_sack_rebuild_cb (gpointer data, gpointer user_data)
+{
+	GPtrArray *sources = data;
+	HifSackAddFlags flags = HIF_SACK_ADD_FLAG_REMOTE |
+				HIF_SACK_ADD_FLAG_FILELISTS;
+	HifSackCacheItem *cache_item;
+	PkBackend *backend = user_data;
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (backend);
+	gboolean valid;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_object_unref_ HifState *state = NULL;
+
+	pk_backend_lock_shared (priv);
+	g_mutex_lock (&priv->sack_build_mutex);
+
+	/* a job may have been quicker */
+	g_mutex_lock (&priv->sack_mutex);
+	valid = hif_utils_lookup_cached_sack (priv, flags) != NULL;
+	g_mutex_unlock (&priv->sack_mutex);
+
+	if (!valid) {
+		state = hif_state_new ();
+		cache_item = hif_utils_build_sack (backend, sources, G_MAXUINT,
+						   flags, state, &error);
+		if (cache_item == NULL)
+			g_warning ("failed to rebuild sack: %s", error->message);
+		else
+			hif_sack_cache_item_unref (cache_item);
+	}
+
+	g_mutex_unlock (&priv->sack_build_mutex);
+	pk_backend_unlock_shared (priv);
+	g_ptr_array_unref (sources);
+}
+
 /**
  * pk_backend_refresh_cache_thread:
  */
@@ -1385,19 +1772,17 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	HifSource *src;
 	HifState *state_local;
 	HifState *state_loop;
-	HySack sack = NULL;
 	PkBackendHifJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendHifPrivate *priv = pk_backend_get_user_data (job_data->backend);
 	gboolean force;
 	gboolean ret;
+	gboolean updated;
 	guint cnt = 0;
 	guint i;
 	_cleanup_error_free_ GError *error = NULL;
 
 	/* set state */
-	hif_state_set_steps (job_data->state, NULL,
-			     95, /* download */
-			     5, /* rebuild SAT */
-			     -1);
+	hif_state_set_number_steps (job_data->state, 1);
 
 	g_variant_get (params, "(b)", &force);
 
@@ -1439,13 +1824,21 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		}
 
 		/* check and download */
+		updated = FALSE;
 		state_loop = hif_state_get_child (state_local);
-		ret = pk_backend_refresh_source (job, src, state_loop, &error);
+		ret = pk_backend_refresh_source (job, src, &updated, state_loop, &error);
 		if (!ret) {
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
 			return;
 		}
 
+		/* only the sacks with this source have to be loaded again */
+		if (updated) {
+			pk_backend_sack_cache_invalidate_source (job_data->backend,
+								 hif_source_get_id (src),
+								 "metadata was refreshed");
+		}
+
 		/* done */
 		ret = hif_state_done (state_local, &error);
 		if (!ret) {
@@ -1461,22 +1854,15 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* regenerate the libsolv metadata */
-	state_local = hif_state_get_child (job_data->state);
-	sack = hif_utils_create_sack_for_filters (job, 0,
-						  HIF_CREATE_SACK_FLAG_NONE,
-						  state_local, &error);
-	if (sack == NULL) {
-		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
-	}
-
-	/* done */
-	ret = hif_state_done (job_data->state, &error);
-	if (!ret) {
-		pk_backend_job_error_code (job, error->code, "%s", error->message);
-		return;
+	/* regenerate the libsolv metadata once the refresh has finished */
+	if (priv->rebuild_pool == NULL) {
+		priv->rebuild_pool = g_thread_pool_new (pk_backend_sack_rebuild_cb,
+							job_data->backend,
+							1, FALSE, NULL);
 	}
+	g_thread_pool_push (priv->rebuild_pool,
+			    g_ptr_array_ref (job_data->sources),
+			    NULL);
 }
 
 /**
@@ -1487,7 +1873,7 @@ pk_backend_refresh_cache (PkBackend *backend,
 			  PkBackendJob *job,
 			  gboolean force)
 {
-	pk_backend_job_thread_create (job, pk_backend_refresh_cache_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_refresh_cache_thread);
 }
 
 /**
@@ -1655,7 +2041,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 void
 pk_backend_get_details (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, backend_get_details_thread, NULL, NULL);
+	pk_backend_thread_create (job, backend_get_details_thread);
 }
 
 /**
@@ -1738,7 +2124,7 @@ backend_get_details_local_thread (PkBackendJob *job, GVariant *params, gpointer
 void
 pk_backend_get_details_local (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, backend_get_details_local_thread, NULL, NULL);
+	pk_backend_thread_create (job, backend_get_details_local_thread);
 }
 
 /**
@@ -1821,7 +2207,7 @@ backend_get_files_local_thread (PkBackendJob *job, GVariant *params, gpointer us
 void
 pk_backend_get_files_local (PkBackend *backend, PkBackendJob *job, gchar **files)
 {
-	pk_backend_job_thread_create (job, backend_get_files_local_thread, NULL, NULL);
+	pk_backend_thread_create (job, backend_get_files_local_thread);
 }
 
 /**
@@ -1982,7 +2368,7 @@ pk_backend_download_packages (PkBackend *backend,
 			      gchar **package_ids,
 			      const gchar *directory)
 {
-	pk_backend_job_thread_create (job, pk_backend_download_packages_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_download_packages_thread);
 }
 
 /**
@@ -2350,7 +2736,8 @@ pk_backend_repo_remove_thread (PkBackendJob *job,
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  HIF_CREATE_SACK_FLAG_USE_CACHE |
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -2436,7 +2823,7 @@ pk_backend_repo_remove (PkBackend *backend,
 			const gchar *repo_id,
 			gboolean autoremove)
 {
-	pk_backend_job_thread_create (job, pk_backend_repo_remove_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_repo_remove_thread);
 }
 
 /**
@@ -2551,7 +2938,8 @@ pk_backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  HIF_CREATE_SACK_FLAG_USE_CACHE |
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -2640,7 +3028,7 @@ pk_backend_remove_packages (PkBackend *backend, PkBackendJob *job,
 			    gboolean allow_deps,
 			    gboolean autoremove)
 {
-	pk_backend_job_thread_create (job, pk_backend_remove_packages_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_remove_packages_thread);
 }
 
 /**
@@ -2681,7 +3069,8 @@ pk_backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointe
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  HIF_CREATE_SACK_FLAG_USE_CACHE |
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -2766,7 +3155,7 @@ pk_backend_install_packages (PkBackend *backend, PkBackendJob *job,
 			     PkBitfield transaction_flags,
 			     gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, pk_backend_install_packages_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_install_packages_thread);
 }
 
 /**
@@ -2808,7 +3197,7 @@ pk_backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer u
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_NONE,
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -2875,7 +3264,7 @@ pk_backend_install_files (PkBackend *backend, PkBackendJob *job,
 			  PkBitfield transaction_flags,
 			  gchar **full_paths)
 {
-	pk_backend_job_thread_create (job, pk_backend_install_files_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_install_files_thread);
 }
 
 /**
@@ -2917,7 +3306,8 @@ pk_backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  HIF_CREATE_SACK_FLAG_USE_CACHE |
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -3009,7 +3399,7 @@ void
 pk_backend_update_packages (PkBackend *backend, PkBackendJob *job,
 			    PkBitfield transaction_flags, gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, pk_backend_update_packages_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_update_packages_thread);
 }
 
 /**
@@ -3086,7 +3476,8 @@ pk_backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	state_local = hif_state_get_child (job_data->state);
 	sack = hif_utils_create_sack_for_filters (job,
 						  filters,
-						  HIF_CREATE_SACK_FLAG_USE_CACHE,
+						  HIF_CREATE_SACK_FLAG_USE_CACHE |
+						  HIF_CREATE_SACK_FLAG_FILELISTS,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -3159,7 +3550,7 @@ pk_backend_get_files (PkBackend *backend,
 		      PkBackendJob *job,
 		      gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, pk_backend_get_files_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_get_files_thread);
 }
 
 /**
@@ -3303,7 +3694,7 @@ pk_backend_get_update_detail (PkBackend *backend,
 			      PkBackendJob *job,
 			      gchar **package_ids)
 {
-	pk_backend_job_thread_create (job, pk_backend_get_update_detail_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_get_update_detail_thread);
 }
 
 /**
@@ -3373,5 +3764,5 @@ pk_backend_repair_system (PkBackend *backend,
 			  PkBackendJob *job,
 			  PkBitfield transaction_flags)
 {
-	pk_backend_job_thread_create (job, pk_backend_repair_system_thread, NULL, NULL);
+	pk_backend_thread_create (job, pk_backend_repair_system_thread);
 }
@@ -26,7 +26,9 @@
 
 #include <iterator>
 #include <list>
+#include <locale.h>
 #include <map>
+#include <memory>
 #include <pthread.h>
 #include <set>
 #include <sstream>
@@ -35,6 +37,7 @@
 #include <string>
 #include <sys/vfs.h>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 #include <glib.h>
@@ -99,6 +102,11 @@ using zypp::filesystem::PathInfo;
 #undef ZYPP_BASE_LOGGER_LOGGROUP
 #define ZYPP_BASE_LOGGER_LOGGROUP "packagekit"
 
+// rewritten by every rpm transaction in /var/lib/rpm
+#define ZYPP_RPMDB_PACKAGES "/var/lib/rpm/Packages"
+
+#define ZYPP_VENDOR_CONF "/etc/PackageKit/ZYpp.conf"
+
 typedef enum {
         INSTALL,
         REMOVE,
@@ -106,11 +114,22 @@ typedef enum {
 } PerformType;
 
 
+/// \class ZyppJob
+/// \brief Gives the job access to the pool for its lifetime.
+///
+/// Read-only jobs reuse the pool once it's built and use it one at a
+/// time, the others get it for themselves and may change it.
 class ZyppJob {
  public:
-	ZyppJob(PkBackendJob *job);
+	ZyppJob(PkBackendJob *job, gboolean exclusive = TRUE);
 	~ZyppJob();
 	zypp::ZYpp::Ptr get_zypp();
+	void share();
+
+ private:
+	PkBackendJob *_job;
+	gboolean _exclusive;
+	gboolean _failed;
 };
 
 enum PkgSearchType {
@@ -528,16 +547,198 @@ class PkBackendZYppPrivate {
 	PkBackendJob *currentJob;
 	
 	pthread_mutex_t zypp_mutex;
+	pthread_cond_t zypp_cond;
+	// held for the whole job by the read-only ones too: queries write
+	// the scratch space and hashes of the sat pool, ZYpp::Ptr is not
+	// counted atomically and the log streams have no locks
+	pthread_mutex_t query_mutex;
+	guint readers;
+	guint writers_waiting;
+	gboolean writer;
+	gboolean pool_ready;
+	gboolean rpmdb_changed;
+	time_t rpmdb_mtime;	// of the rpmdb the target was loaded from
+	gboolean reload_target;
 };
 
 }; // namespace ZyppBackend
 
 using namespace ZyppBackend;
 
-ZyppJob::ZyppJob(PkBackendJob *job)
+/**
+ * Sets the proxy of the job, only jobs with the pool for themselves
+ * download anything, so the environment is changed while they run
+ */
+static void
+zypp_set_proxy (PkBackendJob *job)
+{
+	gchar *proxy_http;
+	gchar *proxy_https;
+	gchar *proxy_ftp;
+	gchar *uri;
+	gchar *proxy_socks;
+	gchar *no_proxy;
+	gchar *pac;
+
+	/* http_proxy */
+	proxy_http = pk_backend_job_get_proxy_http (job);
+	if (!pk_strzero (proxy_http)) {
+		uri = pk_backend_spawn_convert_uri (proxy_http);
+		g_setenv ("http_proxy", uri, TRUE);
+		g_free (uri);
+	}
+
+	/* https_proxy */
+	proxy_https = pk_backend_job_get_proxy_https (job);
+	if (!pk_strzero (proxy_https)) {
+		uri = pk_backend_spawn_convert_uri (proxy_https);
+		g_setenv ("https_proxy", uri, TRUE);
+		g_free (uri);
+	}
+
+	/* ftp_proxy */
+	proxy_ftp = pk_backend_job_get_proxy_ftp (job);
+	if (!pk_strzero (proxy_ftp)) {
+		uri = pk_backend_spawn_convert_uri (proxy_ftp);
+		g_setenv ("ftp_proxy", uri, TRUE);
+		g_free (uri);
+	}
+
+	/* socks_proxy */
+	proxy_socks = pk_backend_job_get_proxy_socks (job);
+	if (!pk_strzero (proxy_socks)) {
+		uri = pk_backend_spawn_convert_uri (proxy_socks);
+		g_setenv ("socks_proxy", uri, TRUE);
+		g_free (uri);
+	}
+
+	/* no_proxy */
+	no_proxy = pk_backend_job_get_no_proxy (job);
+	if (!pk_strzero (no_proxy)) {
+		g_setenv ("no_proxy", no_proxy, TRUE);
+	}
+
+	/* pac */
+	pac = pk_backend_job_get_pac (job);
+	if (!pk_strzero (pac)) {
+		uri = pk_backend_spawn_convert_uri (pac);
+		g_setenv ("pac", uri, TRUE);
+		g_free (uri);
+	}
+
+	g_free (proxy_http);
+	g_free (proxy_https);
+	g_free (proxy_ftp);
+	g_free (proxy_socks);
+	g_free (no_proxy);
+	g_free (pac);
+}
+
+/**
+ * Unsets the proxy info of the job
+ */
+static void
+zypp_unset_proxy ()
+{
+	g_unsetenv ("http_proxy");
+	g_unsetenv ("ftp_proxy");
+	g_unsetenv ("https_proxy");
+	g_unsetenv ("no_proxy");
+	g_unsetenv ("socks_proxy");
+	g_unsetenv ("pac");
+}
+
+ResPool zypp_build_pool (ZYpp::Ptr zypp);
+
+/**
+ * Jobs run in parallel, so each thread uses the locale of its job instead
+ * of changing the one of the daemon. The locales are kept for the next jobs.
+ */
+static locale_t
+zypp_job_locale (const gchar *name)
+{
+	static GMutex lock;
+	static map<string, locale_t> locales;
+	locale_t loc;
+
+	g_mutex_lock (&lock);
+	map<string, locale_t>::const_iterator it = locales.find (name);
+	if (it != locales.end ()) {
+		loc = it->second;
+	} else {
+		loc = newlocale (LC_ALL_MASK, name, (locale_t) 0);
+		if (loc == (locale_t) 0)
+			MIL << "failed to load the locale " << name << endl;
+		locales[name] = loc;
+	}
+	g_mutex_unlock (&lock);
+	return loc;
+}
+
+/**
+ * Makes the thread use the locale of the job
+ */
+static void
+zypp_use_job_locale (PkBackendJob *job)
+{
+	gchar *locale = pk_backend_job_get_locale (job);
+	if (!pk_strzero (locale)) {
+		locale_t loc = zypp_job_locale (locale);
+		if (loc != (locale_t) 0)
+			uselocale (loc);
+	}
+	g_free (locale);
+}
+
+/**
+ * Whether the rpmdb changed since the target was loaded. The file monitor
+ * can miss a change, e.g. when the file is replaced rather than written,
+ * so the mtime is compared as well. The caller holds zypp_mutex
+ */
+static gboolean
+zypp_rpmdb_changed (void)
+{
+	if (priv->rpmdb_changed)
+		return TRUE;
+	return PathInfo (ZYPP_RPMDB_PACKAGES).mtime () != priv->rpmdb_mtime;
+}
+
+ZyppJob::ZyppJob(PkBackendJob *job, gboolean exclusive)
+	: _job(job), _exclusive(exclusive), _failed(FALSE)
 {
-	MIL << "locking zypp" << std::endl;
 	pthread_mutex_lock(&priv->zypp_mutex);
+	if (!exclusive) {
+		// don't let a stream of readers starve a waiting writer
+		while (priv->writer || priv->writers_waiting > 0)
+			pthread_cond_wait(&priv->zypp_cond, &priv->zypp_mutex);
+		if (priv->pool_ready && !zypp_rpmdb_changed ()) {
+			priv->readers++;
+			pthread_mutex_unlock(&priv->zypp_mutex);
+
+			// the readers keep the built pool, but still use it in turn
+			pthread_mutex_lock(&priv->query_mutex);
+			MIL << "locking zypp for reading" << std::endl;
+			zypp_use_job_locale (job);
+			return;
+		}
+		// the pool has to be built before it can be shared
+		_exclusive = TRUE;
+	}
+
+	priv->writers_waiting++;
+	while (priv->writer || priv->readers > 0)
+		pthread_cond_wait(&priv->zypp_cond, &priv->zypp_mutex);
+	priv->writers_waiting--;
+	priv->writer = TRUE;
+	// only reload the installed packages while nobody else reads them
+	if (zypp_rpmdb_changed ()) {
+		priv->reload_target = TRUE;
+		priv->rpmdb_changed = FALSE;
+	}
+	pthread_mutex_unlock(&priv->zypp_mutex);
+
+	MIL << "locking zypp" << std::endl;
+	zypp_use_job_locale (job);
 
 	if (priv->currentJob) {
 		MIL << "currentjob is already defined - highly impossible" << endl;
@@ -546,15 +747,73 @@ ZyppJob::ZyppJob(PkBackendJob *job)
 	pk_backend_job_set_locked(job, true);
 	priv->currentJob = job;
 	priv->eventDirector.setJob(job);
+	zypp_set_proxy (job);
+
+	if (!exclusive)
+		share();
 }
 
 ZyppJob::~ZyppJob()
 {
-	if (priv->currentJob)
-		pk_backend_job_set_locked(priv->currentJob, false);
+	uselocale (LC_GLOBAL_LOCALE);
+
+	if (!_exclusive) {
+		MIL << "unlocking zypp for reading" << std::endl;
+		pthread_mutex_unlock(&priv->query_mutex);
+	}
+
+	pthread_mutex_lock(&priv->zypp_mutex);
+	if (_exclusive) {
+		if (priv->currentJob)
+			pk_backend_job_set_locked(priv->currentJob, false);
+		priv->currentJob = 0;
+		priv->eventDirector.setJob(0);
+		zypp_unset_proxy ();
+
+		// the job may have changed the pool or the target
+		priv->pool_ready = FALSE;
+		priv->writer = FALSE;
+		MIL << "unlocking zypp" << std::endl;
+	} else {
+		priv->readers--;
+	}
+	pthread_cond_broadcast(&priv->zypp_cond);
+	pthread_mutex_unlock(&priv->zypp_mutex);
+}
+
+/**
+ * Builds the pool and lets the read-only jobs use it together with
+ * this one, which must not change it anymore
+ */
+void
+ZyppJob::share()
+{
+	if (!_exclusive)
+		return;
+
+	ZYpp::Ptr zypp = get_zypp();
+	if (zypp != NULL) {
+		zypp_build_pool (zypp);
+
+		// these are created on demand, so don't leave it to the readers
+		zypp->pool ().proxy ();
+		sat::Pool::instance ().prepare ();
+	}
+
+	pk_backend_job_set_locked(priv->currentJob, false);
 	priv->currentJob = 0;
 	priv->eventDirector.setJob(0);
-	MIL << "unlocking zypp" << std::endl;
+	zypp_unset_proxy ();
+
+	MIL << "sharing zypp" << std::endl;
+	// nobody else uses the pool while this job is the writer
+	pthread_mutex_lock(&priv->query_mutex);
+	pthread_mutex_lock(&priv->zypp_mutex);
+	priv->pool_ready = zypp != NULL;
+	priv->writer = FALSE;
+	priv->readers++;
+	_exclusive = FALSE;
+	pthread_cond_broadcast(&priv->zypp_cond);
 	pthread_mutex_unlock(&priv->zypp_mutex);
 }
 
@@ -567,6 +826,10 @@ ZyppJob::get_zypp()
 	static gboolean initialized = FALSE;
 	ZYpp::Ptr zypp = NULL;
 
+	// the error was already reported
+	if (_failed)
+		return NULL;
+
 	try {
 		zypp = ZYppFactory::instance ().getZYpp ();
 
@@ -579,10 +842,12 @@ ZyppJob::get_zypp()
 			initialized = TRUE;
 		}
 	} catch (const ZYppFactoryException &ex) {
-		pk_backend_job_error_code (priv->currentJob, PK_ERROR_ENUM_FAILED_INITIALIZATION, ex.asUserString().c_str() );
+		pk_backend_job_error_code (_job, PK_ERROR_ENUM_FAILED_INITIALIZATION, ex.asUserString().c_str() );
+		_failed = TRUE;
 		return NULL;
 	} catch (const Exception &ex) {
-		pk_backend_job_error_code (priv->currentJob, PK_ERROR_ENUM_INTERNAL_ERROR, ex.asUserString().c_str() );
+		pk_backend_job_error_code (_job, PK_ERROR_ENUM_INTERNAL_ERROR, ex.asUserString().c_str() );
+		_failed = TRUE;
 		return NULL;
 	}
 
@@ -686,28 +951,25 @@ zypp_is_valid_repo (PkBackendJob *job, RepoInfo repo)
 /**
  * Build and return a ResPool that contains all local resolvables
  * and ones found in the enabled repositories.
+ *
+ * The local resolvables stay in the pool, the roles that only want
+ * the installed or the available ones filter them instead. The rpmdb
+ * is only parsed again when it was changed since it was loaded.
  */
 ResPool
-zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
+zypp_build_pool (ZYpp::Ptr zypp)
 {
 	static gboolean repos_loaded = FALSE;
 
-	// the target is loaded or unloaded on request
-	if (include_local) {
-		// FIXME have to wait for fix in zypp (repeated loading of target)
-		if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Add local resolvables
-			Target_Ptr target = zypp->target ();
-			target->load ();
-		}
-	} else {
-		if (!sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Remove local resolvables
-			Repository repository = sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias());
-			repository.eraseFromPool ();
-		}
+	if (priv->reload_target ||
+	    sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
+	{
+		// Add local resolvables
+		MIL << "loading the target" << endl;
+		Target_Ptr target = zypp->target ();
+		priv->rpmdb_mtime = PathInfo (ZYPP_RPMDB_PACKAGES).mtime ();
+		target->load ();
+		priv->reload_target = FALSE;
 	}
 
 	// we only load repositories once.
@@ -746,19 +1008,92 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 }
 
 /**
-  * Return the rpmHeader of a package
+ * The most recently used rpm headers by zypp_rpm_header_key(), dropped
+ * when the content of the pool changed
+ */
+#define ZYPP_RPM_HEADER_CACHE_SIZE	64
+// above this many packages a single walk over the rpmdb is cheaper
+#define ZYPP_RPM_HEADER_BATCH_MIN	16
+
+typedef pair<string, target::rpm::RpmHeader::constPtr> RpmHeaderCacheEntry;
+static list<RpmHeaderCacheEntry> _rpm_header_cache;
+static unsigned _rpm_header_cache_serial = 0;
+static GMutex _rpm_header_cache_lock;
+
+// multilib packages only differ by their arch
+static string
+zypp_rpm_header_key (const string &name, const Edition &edition, const string &arch)
+{
+	return name + "-" + edition.asString () + "." + arch;
+}
+
+static void
+zypp_rpm_header_cache_add (const string &key, target::rpm::RpmHeader::constPtr header)
+{
+	_rpm_header_cache.push_front (make_pair (key, header));
+	if (_rpm_header_cache.size () > ZYPP_RPM_HEADER_CACHE_SIZE)
+		_rpm_header_cache.pop_back ();
+}
+
+/**
+  * Looks up the rpmHeaders of many installed packages at once, the ones
+  * not in the rpmdb are left out of headers
   */
-target::rpm::RpmHeader::constPtr
-zypp_get_rpmHeader (const string &name, Edition edition)
+static void
+zypp_get_rpmHeaders (const vector<sat::Solvable> &solvables,
+		     map<string, target::rpm::RpmHeader::constPtr> &headers)
 {
-	target::rpm::librpmDb::db_const_iterator it;
-	target::rpm::RpmHeader::constPtr result = new target::rpm::RpmHeader ();
+	set<string> missing;
 
-	for (it.findPackage (name, edition); *it; ++it) {
-		result = *it;
+	g_mutex_lock (&_rpm_header_cache_lock);
+	if (ResPool::instance ().serial ().serial () != _rpm_header_cache_serial) {
+		_rpm_header_cache.clear ();
+		_rpm_header_cache_serial = ResPool::instance ().serial ().serial ();
 	}
 
-	return result;
+	for (vector<sat::Solvable>::const_iterator it = solvables.begin (); it != solvables.end (); ++it) {
+		string key = zypp_rpm_header_key (it->name (), it->edition (), it->arch ().asString ());
+		list<RpmHeaderCacheEntry>::iterator cached;
+		for (cached = _rpm_header_cache.begin (); cached != _rpm_header_cache.end (); ++cached) {
+			if (cached->first == key)
+				break;
+		}
+		if (cached != _rpm_header_cache.end ()) {
+			_rpm_header_cache.splice (_rpm_header_cache.begin (), _rpm_header_cache, cached);
+			headers[key] = cached->second;
+		} else {
+			missing.insert (key);
+		}
+	}
+
+	try {
+		target::rpm::librpmDb::db_const_iterator it;
+		if (missing.size () >= ZYPP_RPM_HEADER_BATCH_MIN) {
+			for (it.findAll (); *it && !missing.empty (); ++it) {
+				string key = zypp_rpm_header_key ((*it)->tag_name (), (*it)->tag_edition (), (*it)->tag_arch ());
+				if (missing.erase (key) == 0)
+					continue;
+				headers[key] = *it;
+				zypp_rpm_header_cache_add (key, *it);
+			}
+		} else {
+			for (vector<sat::Solvable>::const_iterator sit = solvables.begin (); sit != solvables.end (); ++sit) {
+				string key = zypp_rpm_header_key (sit->name (), sit->edition (), sit->arch ().asString ());
+				if (missing.erase (key) == 0)
+					continue;
+				for (it.findPackage (sit->name (), sit->edition ()); *it; ++it) {
+					if ((*it)->tag_arch () == sit->arch ().asString ())
+						headers[key] = *it;
+				}
+				if (headers.find (key) != headers.end ())
+					zypp_rpm_header_cache_add (key, headers[key]);
+			}
+		}
+	} catch (...) {
+		g_mutex_unlock (&_rpm_header_cache_lock);
+		throw;
+	}
+	g_mutex_unlock (&_rpm_header_cache_lock);
 }
 
 /**
@@ -846,7 +1181,7 @@ zypp_get_packages_by_file (ZYpp::Ptr zypp,
 			   const gchar *search_file,
 			   vector<sat::Solvable> &ret)
 {
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 
 	string file (search_file);
 
@@ -870,6 +1205,52 @@ zypp_get_packages_by_file (ZYpp::Ptr zypp,
 	}
 }
 
+/**
+ * The solvables of the pool by package_id, built again when the content
+ * of the pool changed since it was last needed
+ */
+static GHashTable *_package_id_index = NULL;
+static unsigned _package_id_index_serial = 0;
+static GMutex _package_id_index_lock;
+
+static gchar *
+zypp_package_id_key (const gchar *name, const gchar *version, const gchar *arch, const gchar *data)
+{
+	// all the installed packages have the same data
+	if (g_str_has_prefix (data, "installed"))
+		data = "installed";
+	return g_strjoin (";", name, version, arch, data, NULL);
+}
+
+static void
+zypp_update_package_id_index (void)
+{
+	ResPool pool = ResPool::instance();
+	if (_package_id_index != NULL &&
+	    pool.serial ().serial () == _package_id_index_serial)
+		return;
+
+	if (_package_id_index != NULL)
+		g_hash_table_unref (_package_id_index);
+	_package_id_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	_package_id_index_serial = pool.serial ().serial ();
+
+	for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
+		sat::Solvable pkg = it->satSolvable();
+		const gchar *arch = isKind<SrcPackage>(pkg) ? "source" : pkg.arch ().c_str ();
+		string data = pkg.isSystem () ? "installed" : pkg.repository ().alias ();
+		gchar *key = zypp_package_id_key (pkg.name ().c_str (), pkg.edition ().c_str (),
+						  arch, data.c_str ());
+
+		// keep the first one, like looking them up by name did
+		if (g_hash_table_contains (_package_id_index, key))
+			g_free (key);
+		else
+			g_hash_table_insert (_package_id_index, key, GUINT_TO_POINTER (pkg.id ()));
+	}
+	MIL << "indexed " << g_hash_table_size (_package_id_index) << " package ids" << endl;
+}
+
 /**
  * Returns the Resolvable for the specified package_id.
  * e.g. gnome-packagekit;3.6.1-132.1;x86_64;G:F
@@ -887,54 +1268,24 @@ zypp_get_package_by_id (const gchar *package_id)
 	const gchar *arch = id_parts[PK_PACKAGE_ID_ARCH];
 	if (!arch)
 		arch = "noarch";
-	bool want_source = !g_strcmp0 (arch, "source");
-	
-	sat::Solvable package;
-
-	ResPool pool = ResPool::instance();
+	gchar *key = zypp_package_id_key (id_parts[PK_PACKAGE_ID_NAME],
+					  id_parts[PK_PACKAGE_ID_VERSION],
+					  arch, id_parts[PK_PACKAGE_ID_DATA]);
 
-	// Iterate over the resolvables and mark the one we want to check its dependencies
-	for (ResPool::byName_iterator it = pool.byNameBegin (id_parts[PK_PACKAGE_ID_NAME]);
-	     it != pool.byNameEnd (id_parts[PK_PACKAGE_ID_NAME]); ++it) {
-		
-		sat::Solvable pkg = it->satSolvable();
-		//MIL << "match " << package_id << " " << pkg << endl;
+	sat::Solvable package;
+	gpointer id;
 
-		if (want_source && !isKind<SrcPackage>(pkg)) {
-			//MIL << "not a src package\n";
-			continue;
-		}
+	// read-only jobs look packages up at the same time
+	g_mutex_lock (&_package_id_index_lock);
+	zypp_update_package_id_index ();
+	if (g_hash_table_lookup_extended (_package_id_index, key, NULL, &id))
+		package = sat::Solvable (GPOINTER_TO_UINT (id));
+	g_mutex_unlock (&_package_id_index_lock);
 
-		if (!want_source && (isKind<SrcPackage>(pkg) || g_strcmp0 (pkg.arch().c_str(), arch))) {
-			//MIL << "not a matching arch\n";
-			continue;
-		}
-
-		const string &ver = pkg.edition ().asString();
-		if (g_strcmp0 (ver.c_str (), id_parts[PK_PACKAGE_ID_VERSION])) {
-			//MIL << "not a matching version\n";
-			continue;
-		}
-
-		if (!pkg.isSystem()) {
-			if (!strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
-				//MIL << "pkg is not installed\n";
-				continue;
-			}
-			if (g_strcmp0(pkg.repository().alias().c_str(), id_parts[PK_PACKAGE_ID_DATA])) {
-				//MIL << "repo does not match\n";
-				continue;
-			}
-		} else if (strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
-			//MIL << "pkg installed\n";
-			continue;
-		}
-
-		MIL << "found " << pkg << endl;
-		package = pkg;
-		break;
-	}
+	if (package != sat::Solvable::noSolvable)
+		MIL << "found " << package << endl;
 
+	g_free (key);
 	g_strfreev (id_parts);
 	return package;
 }
@@ -1217,6 +1568,72 @@ zypp_get_patches (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &patches)
 	}
 }
 
+/**
+  * The settings of the vendor in ZYPP_VENDOR_CONF:
+  *
+  *   [Updates]
+  *   HidePackages=true	only offer the patches as updates
+  *
+  *   [Search]
+  *   IndexDetails=true	search the details in an in-memory copy of the
+  *			names and descriptions, which costs the memory of
+  *			all the descriptions but finds the same packages
+  *			as the query, case sensitive on name and description
+  */
+typedef struct {
+	bool hidePackages;	// only offer the patches as updates
+	bool indexDetails;	// search the details in an index of the descriptions
+} ZyppVendorConf;
+
+/**
+  * Returns the settings of the vendor, the configuration is only parsed
+  * again when it changed
+  */
+static ZyppVendorConf
+zypp_get_vendor_conf (void)
+{
+	static GMutex lock;
+	static time_t mtime = 0;
+	static ZyppVendorConf conf = { false, false };
+	ZyppVendorConf ret;
+
+	g_mutex_lock (&lock);
+	PathInfo info (ZYPP_VENDOR_CONF);
+	if (!info.isExist ()) {
+		mtime = 0;
+		conf.hidePackages = false;
+		conf.indexDetails = false;
+	} else if (info.mtime () != mtime) {
+		conf.hidePackages = false;
+		conf.indexDetails = false;
+		parser::IniDict vendorConf(InputStream(ZYPP_VENDOR_CONF));
+		if (vendorConf.hasSection("Updates")) {
+			for ( parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Updates");
+			      eit != vendorConf.entriesEnd("Updates");
+			      ++eit )
+			{
+				if ((*eit).first == "HidePackages" &&
+				    str::strToTrue((*eit).second))
+					conf.hidePackages = true;
+			}
+		}
+		if (vendorConf.hasSection("Search")) {
+			for ( parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Search");
+			      eit != vendorConf.entriesEnd("Search");
+			      ++eit )
+			{
+				if ((*eit).first == "IndexDetails" &&
+				    str::strToTrue((*eit).second))
+					conf.indexDetails = true;
+			}
+		}
+		mtime = info.mtime ();
+	}
+	ret = conf;
+	g_mutex_unlock (&lock);
+	return ret;
+}
+
 /**
   * Return the best, most friendly selection of update patches and packages that
   * we can find. Also manages _updating_self to prioritise critical infrastructure
@@ -1235,49 +1652,49 @@ zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
 			patchRepo = candidates.begin ()->resolvable ()->repoInfo ().alias ();
 		}
 
-		bool hidePackages = false;
-		if (PathInfo("/etc/PackageKit/ZYpp.conf").isExist()) {
-			parser::IniDict vendorConf(InputStream("/etc/PackageKit/ZYpp.conf"));
-			if (vendorConf.hasSection("Updates")) {
-				for ( parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Updates");
-				      eit != vendorConf.entriesEnd("Updates");
-				      ++eit )
-				{
-					if ((*eit).first == "HidePackages" &&
-					    str::strToTrue((*eit).second))
-						hidePackages = true;
-				}
-			}
-		}
-
-		if (!hidePackages)
+		if (!zypp_get_vendor_conf ().hidePackages)
 		{
 			set<PoolItem> packages;
 			zypp_get_package_updates(patchRepo, packages);
 
+			// collect what the patches contain, many patches share packages
+			sat::SolvableSet patched;
 			pi_it_t cb = candidates.begin (), ce = candidates.end (), ci;
 			for (ci = cb; ci != ce; ++ci) {
 				if (!isKind<Patch>(ci->resolvable()))
 					continue;
 
 				Patch::constPtr patch = asKind<Patch>(ci->resolvable());
-
-				// Remove contained packages from list of packages to add
-				sat::SolvableSet::const_iterator pki;
 				Patch::Contents content(patch->contents());
-				for (pki = content.begin(); pki != content.end(); ++pki) {
-
-					pi_it_t pb = packages.begin (), pe = packages.end (), pi;
-					for (pi = pb; pi != pe; ++pi) {
-						if (pi->satSolvable() == sat::Solvable::noSolvable)
-							continue;
+				patched.insert (content.begin (), content.end ());
+			}
 
-						if (pi->satSolvable().identical (*pki)) {
-							packages.erase (pi);
+			// the packages may come from another repository than the
+			// patch, so only the ones with the same name are compared
+			typedef unordered_multimap<sat::detail::IdType, sat::Solvable> name_map_t;
+			name_map_t byName;
+			for (sat::SolvableSet::const_iterator pki = patched.begin (); pki != patched.end (); ++pki)
+				byName.insert (make_pair (pki->ident ().id (), *pki));
+
+			// Remove contained packages from list of packages to add
+			pi_it_t pi = packages.begin ();
+			while (pi != packages.end ()) {
+				sat::Solvable solvable = pi->satSolvable ();
+				bool contained = false;
+				if (solvable != sat::Solvable::noSolvable) {
+					pair<name_map_t::const_iterator, name_map_t::const_iterator> range =
+						byName.equal_range (solvable.ident ().id ());
+					for (name_map_t::const_iterator it = range.first; it != range.second; ++it) {
+						if (solvable.identical (it->second)) {
+							contained = true;
 							break;
 						}
 					}
 				}
+				if (contained)
+					packages.erase (pi++);
+				else
+					++pi;
 			}
 
 			// merge into the list
@@ -1650,7 +2067,9 @@ zypp_backend_finished_error (PkBackendJob  *job, PkErrorEnum err_code,
 
 
 /**
- * We do not pretend we're thread safe when all we do is having a huge mutex
+ * Read-only jobs share the built pool, but libzypp and libsolv are not
+ * safe to query from several threads, so they still use it in turn
+ * (see ZyppJob)
  */
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
@@ -1680,6 +2099,19 @@ pk_backend_get_author (PkBackend *backend)
 			 "ZYpp developers <zypp-devel@opensuse.org>");
 }
 
+/**
+ * pk_backend_rpmdb_changed_cb:
+ */
+static void
+pk_backend_rpmdb_changed_cb (PkBackend *backend, gpointer data)
+{
+	g_debug ("rpmdb changed");
+	pthread_mutex_lock (&priv->zypp_mutex);
+	priv->rpmdb_changed = TRUE;
+	priv->pool_ready = FALSE;
+	pthread_mutex_unlock (&priv->zypp_mutex);
+}
+
 /**
  * pk_backend_initialize:
  * This should only be run once per backend load, i.e. not every transaction
@@ -1691,8 +2123,19 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv = new PkBackendZYppPrivate;
 	priv->currentJob = 0;
 	priv->zypp_mutex = PTHREAD_MUTEX_INITIALIZER;
+	priv->zypp_cond = PTHREAD_COND_INITIALIZER;
+	priv->query_mutex = PTHREAD_MUTEX_INITIALIZER;
+	priv->readers = 0;
+	priv->writers_waiting = 0;
+	priv->writer = FALSE;
+	priv->pool_ready = FALSE;
+	priv->rpmdb_changed = FALSE;
+	priv->rpmdb_mtime = 0;
+	priv->reload_target = FALSE;
 	zypp_logging ();
 
+	pk_backend_watch_file (backend, ZYPP_RPMDB_PACKAGES, pk_backend_rpmdb_changed_cb, NULL);
+
 	g_debug ("zypp_backend_initialize");
 	//_updating_self = FALSE;
 }
@@ -1744,7 +2187,7 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pk_backend_job_set_percentage (job, 10);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 	PoolStatusSaver saver;
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2006,7 +2449,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	g_variant_get (params, "(^a&s)",
 		       &package_ids);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, FALSE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -2198,7 +2641,7 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	pk_backend_job_set_percentage (job, 40);
 
 	set<PoolItem> candidates;
@@ -2319,7 +2762,7 @@ backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer user
 			  job, PK_ERROR_ENUM_INTERNAL_ERROR, "Can't refresh repositories");
 			return;
 		}
-		zypp_build_pool (zypp, true);
+		zypp_build_pool (zypp);
 
 	} catch (const Exception &ex) {
 		zypp_backend_finished_error (
@@ -2476,7 +2919,7 @@ backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointer u
 	
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, TRUE);
+		ResPool pool = zypp_build_pool (zypp);
 		PoolStatusSaver saver;
 		pk_backend_job_set_percentage (job, 10);
 		vector<PoolItem> *items = new vector<PoolItem> ();
@@ -2578,7 +3021,6 @@ backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REMOVE);
 	pk_backend_job_set_percentage (job, 0);
 
-	Target_Ptr target;
 	ZyppJob zjob(job);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
@@ -2587,10 +3029,8 @@ backend_remove_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	}
 	zypp->resolver()->setCleandepsOnRemove(autoremove);
 
-	target = zypp->target ();
-
 	// Load all the local system "resolvables" (packages)
-	target->load ();
+	zypp_build_pool (zypp);
 	pk_backend_job_set_percentage (job, 10);
 
 	PoolStatusSaver saver;
@@ -2662,7 +3102,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 		      &_filters,
 		      &search);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, FALSE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 	
 	if (zypp == NULL){
@@ -2671,7 +3111,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 	
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; search[i]; i++) {
 		MIL << search[i] << " " << pk_filter_bitfield_to_string(_filters) << endl;
@@ -2742,6 +3182,78 @@ pk_backend_resolve (PkBackend *backend, PkBackendJob *job, PkBitfield filters, g
 	pk_backend_job_thread_create (job, backend_resolve_thread, NULL, NULL);
 }
 
+/**
+ * The name and description of the packages in the pool, used to search
+ * the details without looking the attributes up for each search. They
+ * are the attributes the details query looks at, so both find the same
+ * packages
+ */
+typedef struct {
+	sat::Solvable solvable;
+	string name;
+	string description;
+} ZyppDetailsEntry;
+
+typedef vector<ZyppDetailsEntry> ZyppDetailsIndex;
+
+static std::shared_ptr<ZyppDetailsIndex> _details_index;
+static unsigned _details_index_serial = 0;
+static GMutex _details_index_lock;
+
+/**
+ * Returns the details index of the pool, building it again when the
+ * content of the pool changed. It is not changed anymore once returned,
+ * so the read-only jobs can search it at the same time
+ */
+static std::shared_ptr<ZyppDetailsIndex>
+zypp_get_details_index (void)
+{
+	std::shared_ptr<ZyppDetailsIndex> index;
+	ResPool pool = ResPool::instance();
+
+	g_mutex_lock (&_details_index_lock);
+	if (!_details_index ||
+	    pool.serial ().serial () != _details_index_serial) {
+		_details_index.reset (new ZyppDetailsIndex);
+		_details_index_serial = pool.serial ().serial ();
+
+		ResObject::Kind kind = ResTraits<Package>::kind;
+		for (ResPool::byKind_iterator it = pool.byKindBegin (kind); it != pool.byKindEnd (kind); ++it) {
+			ZyppDetailsEntry entry;
+			entry.solvable = it->satSolvable ();
+			entry.name = entry.solvable.name ();
+			entry.description = entry.solvable.lookupStrAttribute (sat::SolvAttr::description);
+			_details_index->push_back (entry);
+		}
+		MIL << "indexed the details of " << _details_index->size () << " packages" << endl;
+	}
+	index = _details_index;
+	g_mutex_unlock (&_details_index_lock);
+	return index;
+}
+
+/**
+ * Whether the solvable matches all the search terms, the query itself
+ * only looked for one of them
+ */
+static gboolean
+zypp_search_matches_all (PkRoleEnum role, const sat::Solvable &solvable, gchar **values)
+{
+	string description;
+	if (role == PK_ROLE_ENUM_SEARCH_DETAILS)
+		description = solvable.lookupStrAttribute (sat::SolvAttr::description);
+
+	for (guint i = 0; values[i]; i++) {
+		if (strstr (solvable.name ().c_str (), values[i]) != NULL)
+			continue;
+		if (role == PK_ROLE_ENUM_SEARCH_DETAILS &&
+		    strstr (description.c_str (), values[i]) != NULL)
+			continue;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 static void
 backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
@@ -2767,22 +3279,55 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		return;
 	}
 
-	search = values[0];  //Fixme - support the possible multiple values (logical OR search)
+	// the search itself doesn't change the pool
+	zjob.share();
+
 	role = pk_backend_job_get_role(job);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
 
+	if (values[0] == NULL)
+		return;
+
 	vector<sat::Solvable> v;
 
+	if (role == PK_ROLE_ENUM_SEARCH_DETAILS && zypp_get_vendor_conf ().indexDetails) {
+		zypp_build_pool (zypp);
+
+		// the same matching as the query below
+		std::shared_ptr<ZyppDetailsIndex> index = zypp_get_details_index ();
+		for (ZyppDetailsIndex::const_iterator it = index->begin (); it != index->end (); ++it) {
+			guint i;
+			for (i = 0; values[i]; i++) {
+				if (strstr (it->name.c_str (), values[i]) == NULL &&
+				    strstr (it->description.c_str (), values[i]) == NULL)
+					break;
+			}
+			if (values[i] == NULL && !zypp_filter_solvable (_filters, it->solvable))
+				v.push_back (it->solvable);
+		}
+
+		zypp_emit_filtered_packages_in_list (job, 0, v);
+		return;
+	}
+
+	// all the names and details have to match, the query looks for the
+	// longest term and the others are checked on its results
+	search = values[0];
+	for (guint i = 1; values[i]; i++) {
+		if (strlen (values[i]) > strlen (search))
+			search = values[i];
+	}
+
 	PoolQuery q;
-	q.addString( search ); // may be called multiple times (OR'ed)
 	q.setCaseSensitive( true );
 	q.setMatchSubstring();
 
 	switch (role) {
 	case PK_ROLE_ENUM_SEARCH_NAME:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
+		q.addString( search );
 		q.addKind( ResKind::package );
 		q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -2791,7 +3336,8 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		// two separate queries.
 		break;
 	case PK_ROLE_ENUM_SEARCH_DETAILS:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
+		q.addString( search );
 		q.addKind( ResKind::package );
 		//q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -2800,7 +3346,10 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		// did not search in srcpackages.
 		break;
 	case PK_ROLE_ENUM_SEARCH_FILE: {
-		zypp_build_pool (zypp, TRUE);
+		zypp_build_pool (zypp);
+		// the packages owning any of the files
+		for (guint i = 0; values[i]; i++)
+			q.addString( values[i] ); // OR'ed
 		q.addKind( ResKind::package );
 		q.addAttribute( sat::SolvAttr::name );
 		q.addAttribute( sat::SolvAttr::description );
@@ -2813,10 +3362,18 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		break;
 	};
 
+	// filter while walking the results, so only what is emitted is kept
 	if ( ! q.empty() ) {
-		copy( q.begin(), q.end(), back_inserter( v ) );
+		for (PoolQuery::const_iterator it = q.begin (); it != q.end (); ++it) {
+			if (zypp_filter_solvable (_filters, *it))
+				continue;
+			if (values[1] != NULL && role != PK_ROLE_ENUM_SEARCH_FILE &&
+			    !zypp_search_matches_all (role, *it, values))
+				continue;
+			v.push_back (*it);
+		}
 	}
-	zypp_emit_filtered_packages_in_list (job, _filters, v);
+	zypp_emit_filtered_packages_in_list (job, 0, v);
 }
 
 /**
@@ -2849,7 +3406,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 		&_filters,
 		&search);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, FALSE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -2867,7 +3424,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	pk_backend_job_set_percentage (job, 30);
 
@@ -3017,8 +3574,10 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		return;
 	}
 
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+
+	vector<sat::Solvable> solvables;
 	for (uint i = 0; package_ids[i]; i++) {
-		pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 		
 		if (zypp_is_no_solvable(solvable)) {
@@ -3027,22 +3586,38 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 				"couldn't find package");
 			return;
 		}
+		solvables.push_back (solvable);
+	}
+
+	// read the headers of all the installed packages together
+	vector<sat::Solvable> installed;
+	for (vector<sat::Solvable>::const_iterator it = solvables.begin (); it != solvables.end (); ++it) {
+		if (it->isSystem ())
+			installed.push_back (*it);
+	}
+	map<string, target::rpm::RpmHeader::constPtr> headers;
+	try {
+		zypp_get_rpmHeaders (installed, headers);
+	} catch (const target::rpm::RpmException &ex) {
+		zypp_backend_finished_error (job, PK_ERROR_ENUM_REPO_NOT_FOUND,
+					     "Couldn't open rpm-database");
+		return;
+	}
+
+	for (uint i = 0; package_ids[i]; i++) {
+		sat::Solvable solvable = solvables[i];
 
 		string temp;
 		if (solvable.isSystem ()){
-			try {
-				target::rpm::RpmHeader::constPtr rpmHeader = zypp_get_rpmHeader (solvable.name (), solvable.edition ());
-				list<string> files = rpmHeader->tag_filenames ();
+			map<string, target::rpm::RpmHeader::constPtr>::iterator header =
+				headers.find (zypp_rpm_header_key (solvable.name (), solvable.edition (), solvable.arch ().asString ()));
+			if (header != headers.end ()) {
+				list<string> files = header->second->tag_filenames ();
 
 				for (list<string>::iterator it = files.begin (); it != files.end (); ++it) {
 					temp.append (*it);
 					temp.append (";");
 				}
-
-			} catch (const target::rpm::RpmException &ex) {
-				zypp_backend_finished_error (job, PK_ERROR_ENUM_REPO_NOT_FOUND,
-							     "Couldn't open rpm-database");
-				return;
 			}
 		} else {
 			temp = "Only available for installed packages";
@@ -3072,7 +3647,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	g_variant_get (params, "(t)",
 		       &_filters);
 
-	ZyppJob zjob(job);
+	ZyppJob zjob(job, FALSE);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -3082,7 +3657,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 
 	vector<sat::Solvable> v;
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 	ResPool pool = ResPool::instance ();
 	for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package); it != pool.byKindEnd (ResKind::package); ++it) {
 		v.push_back (it->satSolvable ());
@@ -3116,7 +3691,7 @@ backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 	if (zypp == NULL){
 		return;
 	}
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PkRestartEnum restart = PK_RESTART_ENUM_NONE;
 
 	PoolStatusSaver saver;
@@ -3333,7 +3908,8 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 		      &_filters,
 		      &values);
 	
-	ZyppJob zjob(job);
+	// only the hardware query changes the pool
+	ZyppJob zjob(job, g_ascii_strcasecmp("drivers_for_attached_hardware", values[0]) == 0);
 	ZYpp::Ptr zypp = zjob.get_zypp();
 
 	if (zypp == NULL){
@@ -3341,7 +3917,7 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	if(g_ascii_strcasecmp("drivers_for_attached_hardware", values[0]) == 0) {
 		// solver run
@@ -3458,13 +4034,15 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, FALSE);
+		ResPool pool = zypp_build_pool (zypp);
 
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 		for (guint i = 0; package_ids[i]; i++) {
 			sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 
-			if (zypp_is_no_solvable(solvable)) {
+			// only the available packages can be downloaded
+			if (zypp_is_no_solvable(solvable) ||
+			    zypp_filter_solvable (pk_bitfield_value (PK_FILTER_ENUM_NOT_INSTALLED), solvable)) {
 				zypp_backend_finished_error (job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
 							     "couldn't find package");
 				return;
@@ -3520,96 +4098,6 @@ pk_backend_download_packages (PkBackend *backend, PkBackendJob *job, gchar **pac
 	pk_backend_job_thread_create (job, backend_download_packages_thread, NULL, NULL);
 }
 
-/**
- * pk_backend_start_job:
- */
-void
-pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
-{
-	gchar *locale;
-	gchar *proxy_http;
-	gchar *proxy_https;
-	gchar *proxy_ftp;
-	gchar *uri;
-	gchar *proxy_socks;
-	gchar *no_proxy;
-	gchar *pac;
-
-	locale = pk_backend_job_get_locale(job);
-	if (!pk_strzero (locale)) {
-		setlocale(LC_ALL, locale);
-	}
-
-	/* http_proxy */
-	proxy_http = pk_backend_job_get_proxy_http (job);
-	if (!pk_strzero (proxy_http)) {
-		uri = pk_backend_spawn_convert_uri (proxy_http);
-		g_setenv ("http_proxy", uri, TRUE);
-		g_free (uri);
-	}
-
-	/* https_proxy */
-	proxy_https = pk_backend_job_get_proxy_https (job);
-	if (!pk_strzero (proxy_https)) {
-		uri = pk_backend_spawn_convert_uri (proxy_https);
-		g_setenv ("https_proxy", uri, TRUE);
-		g_free (uri);
-	}
-
-	/* ftp_proxy */
-	proxy_ftp = pk_backend_job_get_proxy_ftp (job);
-	if (!pk_strzero (proxy_ftp)) {
-		uri = pk_backend_spawn_convert_uri (proxy_ftp);
-		g_setenv ("ftp_proxy", uri, TRUE);
-		g_free (uri);
-	}
-
-	/* socks_proxy */
-	proxy_socks = pk_backend_job_get_proxy_socks (job);
-	if (!pk_strzero (proxy_socks)) {
-		uri = pk_backend_spawn_convert_uri (proxy_socks);
-		g_setenv ("socks_proxy", uri, TRUE);
-		g_free (uri);
-	}
-
-	/* no_proxy */
-	no_proxy = pk_backend_job_get_no_proxy (job);
-	if (!pk_strzero (no_proxy)) {
-		g_setenv ("no_proxy", no_proxy, TRUE);
-	}
-
-	/* pac */
-	pac = pk_backend_job_get_pac (job);
-	if (!pk_strzero (pac)) {
-		uri = pk_backend_spawn_convert_uri (pac);
-		g_setenv ("pac", uri, TRUE);
-		g_free (uri);
-	}
-
-	g_free (locale);
-	g_free (proxy_http);
-	g_free (proxy_https);
-	g_free (proxy_ftp);
-	g_free (proxy_socks);
-	g_free (no_proxy);
-	g_free (pac);
-}
-
-/**
- * pk_backend_stop_job:
- */
-void
-pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
-{
-	/* unset proxy info for this transaction */
-	g_unsetenv ("http_proxy");
-	g_unsetenv ("ftp_proxy");
-	g_unsetenv ("https_proxy");
-	g_unsetenv ("no_proxy");
-	g_unsetenv ("socks_proxy");
-	g_unsetenv ("pac");
-}
-
 
 /**
   * Ask the User if it is OK to import an GPG-Key for a repo
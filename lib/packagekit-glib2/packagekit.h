@@ -46,6 +46,7 @@
 #include <packagekit-glib2/pk-item-progress.h>
 #include <packagekit-glib2/pk-offline.h>
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-id-set.h>
 #include <packagekit-glib2/pk-package-ids.h>
 #include <packagekit-glib2/pk-package-sack.h>
 #include <packagekit-glib2/pk-package-sack-sync.h>
@@ -40,6 +40,7 @@
 
 #include <packagekit-glib2/pk-client.h>
 #include <packagekit-glib2/pk-client-helper.h>
+#include <packagekit-glib2/pk-client-private.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-control.h>
 #include <packagekit-glib2/pk-debug.h>
@@ -68,6 +69,12 @@ struct _PkClientPrivate
 	gboolean		 interactive;
 	gboolean		 idle;
 	guint			 cache_age;
+	gboolean		 legacy_daemon;
+	guint			 transaction_signal_id;
+	guint			 properties_changed_id;
+	guint			 handovers;
+	GPtrArray		*pending;	/* of PkClientState */
+	GQueue			*unclaimed;	/* of PkClientSignal */
 };
 
 enum {
@@ -121,8 +128,20 @@ typedef struct {
 	PkSigTypeEnum			 type;
 	guint				 refcount;
 	PkClientHelper			*client_helper;
+	gboolean			 use_connection_signals;
+	gboolean			 own_signals;
+	guint				 signal_id;
+	guint				 properties_changed_id;
+	gint64				 create_time;
 } PkClientState;
 
+typedef struct {
+	gint64				 time;
+	gchar				*object_path;
+	gchar				*signal_name;
+	GVariant			*parameters;
+} PkClientSignal;
+
 static void
 pk_client_properties_changed_cb (GDBusProxy *proxy,
 				 GVariant *changed_properties,
@@ -134,6 +153,9 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		     const gchar *signal_name,
 		     GVariant *parameters,
 		     gpointer user_data);
+static void
+pk_client_create_transaction (PkClientState *state,
+			      GCancellable *cancellable);
 
 /**
  * pk_client_error_quark:
@@ -567,13 +589,18 @@ pk_client_cancel_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_variant_unref_ GVariant *value = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (G_IS_DBUS_PROXY (source_object)) {
+		value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object),
+						  res, &error);
+	} else {
+		value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+						       res, &error);
+	}
 	if (value == NULL) {
 		/* there's not really a lot we can do here */
 		g_warning ("failed to cancel: %s", error->message);
@@ -590,7 +617,25 @@ pk_client_cancel_cb (GObject *source_object,
 static void
 pk_client_cancellable_cancel_cb (GCancellable *cancellable, PkClientState *state)
 {
-	/* dbus method has not yet fired */
+	/* the transaction was started without a proxy */
+	if (state->use_connection_signals) {
+		g_debug ("cancelling %s", state->tid);
+		g_dbus_connection_call (state->client->priv->connection,
+					PK_DBUS_SERVICE,
+					state->tid,
+					PK_DBUS_INTERFACE_TRANSACTION,
+					"Cancel",
+					NULL,
+					NULL,
+					G_DBUS_CALL_FLAGS_NONE,
+					PK_CLIENT_DBUS_METHOD_TIMEOUT,
+					NULL,
+					pk_client_cancel_cb, state);
+		return;
+	}
+
+	/* dbus method has not yet fired, or CreateTransactionAndRun is in
+	 * flight and its reply will cancel the role */
 	if (state->proxy == NULL) {
 		g_debug ("Cancelled, but no proxy, not sure what to do here");
 		return;
@@ -678,6 +723,13 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	if (state->proxy_props != NULL)
 		g_object_unref (G_OBJECT (state->proxy_props));
 
+	if (state->signal_id != 0) {
+		g_dbus_connection_signal_unsubscribe (state->client->priv->connection,
+						      state->signal_id);
+		g_dbus_connection_signal_unsubscribe (state->client->priv->connection,
+						      state->properties_changed_id);
+	}
+
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
 							   g_object_ref (state->results),
@@ -1423,6 +1475,361 @@ pk_client_proxy_connect (PkClientState *state)
 			  state);
 }
 
+/**
+ * pk_client_signal_free:
+ **/
+static void
+pk_client_signal_free (PkClientSignal *sig)
+{
+	g_free (sig->object_path);
+	g_free (sig->signal_name);
+	g_variant_unref (sig->parameters);
+	g_slice_free (PkClientSignal, sig);
+}
+
+/**
+ * pk_client_get_state_for_tid:
+ **/
+static PkClientState *
+pk_client_get_state_for_tid (PkClient *client, const gchar *tid)
+{
+	PkClientState *state;
+	guint i;
+
+	for (i = 0; i < client->priv->calls->len; i++) {
+		state = g_ptr_array_index (client->priv->calls, i);
+		if (!state->use_connection_signals)
+			continue;
+		if (g_strcmp0 (state->tid, tid) == 0)
+			return state;
+	}
+	return NULL;
+}
+
+/**
+ * pk_client_dispatch_signal:
+ **/
+static void
+pk_client_dispatch_signal (PkClientState *state,
+			   const gchar *signal_name,
+			   GVariant *parameters)
+{
+	if (g_strcmp0 (signal_name, "PropertiesChanged") == 0) {
+		_cleanup_variant_unref_ GVariant *changed = NULL;
+		changed = g_variant_get_child_value (parameters, 1);
+		pk_client_properties_changed_cb (NULL, changed, NULL, state);
+		return;
+	}
+	pk_client_signal_cb (NULL, PK_DBUS_SERVICE, signal_name, parameters, state);
+}
+
+/**
+ * pk_client_connection_signal_cb:
+ **/
+static void
+pk_client_connection_signal_cb (GDBusConnection *connection,
+				const gchar *sender_name,
+				const gchar *object_path,
+				const gchar *interface_name,
+				const gchar *signal_name,
+				GVariant *parameters,
+				gpointer user_data)
+{
+	PkClient *client = PK_CLIENT (user_data);
+	PkClientSignal *sig;
+	PkClientState *state;
+
+	/* the transaction match delivers it once the state has taken over */
+	state = pk_client_get_state_for_tid (client, object_path);
+	if (state != NULL) {
+		if (!state->own_signals)
+			pk_client_dispatch_signal (state, signal_name, parameters);
+		return;
+	}
+
+	/* the daemon can emit signals before we get the tid back, so keep
+	 * them until all the outstanding requests have returned */
+	if (client->priv->pending->len == 0)
+		return;
+	sig = g_slice_new0 (PkClientSignal);
+	sig->time = g_get_monotonic_time ();
+	sig->object_path = g_strdup (object_path);
+	sig->signal_name = g_strdup (signal_name);
+	sig->parameters = g_variant_ref (parameters);
+	g_queue_push_tail (client->priv->unclaimed, sig);
+}
+
+/**
+ * pk_client_claim_signals:
+ *
+ * Replays any signals received for @tid before the transaction ID was
+ * known, and drops any that can no longer be claimed.
+ **/
+static void
+pk_client_claim_signals (PkClient *client, const gchar *tid)
+{
+	GList *l;
+	GList *next;
+	GQueue claimed = G_QUEUE_INIT;
+	PkClientSignal *sig;
+	PkClientState *state;
+	gint64 oldest = G_MAXINT64;
+	guint i;
+
+	/* signals older than every outstanding request cannot be ours */
+	for (i = 0; i < client->priv->pending->len; i++) {
+		state = g_ptr_array_index (client->priv->pending, i);
+		oldest = MIN (oldest, state->create_time);
+	}
+	for (l = client->priv->unclaimed->head; l != NULL; l = next) {
+		next = l->next;
+		sig = l->data;
+		if (g_strcmp0 (sig->object_path, tid) == 0) {
+			g_queue_push_tail (&claimed, sig);
+			g_queue_delete_link (client->priv->unclaimed, l);
+		} else if (sig->time < oldest) {
+			pk_client_signal_free (sig);
+			g_queue_delete_link (client->priv->unclaimed, l);
+		}
+	}
+
+	/* the state may be finished by any of these */
+	while ((sig = g_queue_pop_head (&claimed)) != NULL) {
+		state = pk_client_get_state_for_tid (client, tid);
+		if (state != NULL)
+			pk_client_dispatch_signal (state, sig->signal_name, sig->parameters);
+		pk_client_signal_free (sig);
+	}
+}
+
+/**
+ * pk_client_subscribe_signals:
+ *
+ * Listens to all the transactions, as the daemon can emit signals before
+ * CreateTransactionAndRun returns the tid. Every transaction on the system
+ * matches, so this is only kept while a call is outstanding.
+ **/
+static void
+pk_client_subscribe_signals (PkClient *client)
+{
+	PkClientPrivate *priv = client->priv;
+
+	/* already done */
+	if (priv->transaction_signal_id != 0)
+		return;
+
+	priv->transaction_signal_id =
+		g_dbus_connection_signal_subscribe (priv->connection,
+						    PK_DBUS_SERVICE,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    NULL, /* member */
+						    NULL, /* object_path */
+						    NULL, /* arg0 */
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_connection_signal_cb,
+						    client, NULL);
+	priv->properties_changed_id =
+		g_dbus_connection_signal_subscribe (priv->connection,
+						    PK_DBUS_SERVICE,
+						    "org.freedesktop.DBus.Properties",
+						    "PropertiesChanged",
+						    NULL, /* object_path */
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_connection_signal_cb,
+						    client, NULL);
+}
+
+/**
+ * pk_client_unsubscribe_signals:
+ *
+ * Drops the match on all the transactions when no request needs it.
+ **/
+static void
+pk_client_unsubscribe_signals (PkClient *client)
+{
+	PkClientPrivate *priv = client->priv;
+
+	if (priv->transaction_signal_id == 0)
+		return;
+	if (priv->pending->len > 0 || priv->handovers > 0)
+		return;
+	g_dbus_connection_signal_unsubscribe (priv->connection,
+					      priv->transaction_signal_id);
+	g_dbus_connection_signal_unsubscribe (priv->connection,
+					      priv->properties_changed_id);
+	priv->transaction_signal_id = 0;
+	priv->properties_changed_id = 0;
+}
+
+/**
+ * pk_client_state_signal_cb:
+ **/
+static void
+pk_client_state_signal_cb (GDBusConnection *connection,
+			   const gchar *sender_name,
+			   const gchar *object_path,
+			   const gchar *interface_name,
+			   const gchar *signal_name,
+			   GVariant *parameters,
+			   gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+
+	/* still delivered by the match on all the transactions */
+	if (!state->own_signals)
+		return;
+	pk_client_dispatch_signal (state, signal_name, parameters);
+}
+
+/**
+ * pk_client_state_subscribe_signals:
+ *
+ * Listens to just the transaction of @state, until pk_client_state_finish().
+ **/
+static void
+pk_client_state_subscribe_signals (PkClientState *state)
+{
+	GDBusConnection *connection = state->client->priv->connection;
+
+	state->signal_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    PK_DBUS_SERVICE,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    NULL, /* member */
+						    state->tid,
+						    NULL, /* arg0 */
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_state_signal_cb,
+						    state, NULL);
+	state->properties_changed_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    PK_DBUS_SERVICE,
+						    "org.freedesktop.DBus.Properties",
+						    "PropertiesChanged",
+						    state->tid,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_state_signal_cb,
+						    state, NULL);
+}
+
+typedef struct {
+	PkClient	*client;
+	gchar		*tid;
+} PkClientHandover;
+
+/**
+ * pk_client_handover_cb:
+ **/
+static void
+pk_client_handover_cb (GObject *source_object,
+		       GAsyncResult *res,
+		       gpointer user_data)
+{
+	PkClientHandover *handover = (PkClientHandover *) user_data;
+	PkClientState *state;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+					       res, &error);
+	if (value == NULL)
+		g_debug ("failed to ping the bus: %s", error->message);
+
+	/* the state may have finished already */
+	state = pk_client_get_state_for_tid (handover->client, handover->tid);
+	if (state != NULL)
+		state->own_signals = TRUE;
+	handover->client->priv->handovers--;
+	pk_client_unsubscribe_signals (handover->client);
+
+	g_object_unref (handover->client);
+	g_free (handover->tid);
+	g_slice_free (PkClientHandover, handover);
+}
+
+/**
+ * pk_client_state_handover:
+ *
+ * Moves @state from the match on all the transactions to its own match.
+ * Signals received before the AddMatch for the tid only reach the wide
+ * match, so both are kept until the reply to a Ping sent after it. The
+ * bus and the connection deliver in order, so the wide match dispatches
+ * everything before the reply and the transaction match the rest.
+ **/
+static void
+pk_client_state_handover (PkClientState *state)
+{
+	PkClientHandover *handover;
+
+	handover = g_slice_new0 (PkClientHandover);
+	handover->client = g_object_ref (state->client);
+	handover->tid = g_strdup (state->tid);
+	state->client->priv->handovers++;
+	g_dbus_connection_call (state->client->priv->connection,
+				"org.freedesktop.DBus",
+				"/org/freedesktop/DBus",
+				"org.freedesktop.DBus.Peer",
+				"Ping",
+				NULL,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				-1,
+				NULL,
+				pk_client_handover_cb,
+				handover);
+}
+
+/**
+ * pk_client_transaction_call:
+ **/
+static void
+pk_client_transaction_call (PkClientState *state,
+			    const gchar *method_name,
+			    GVariant *parameters,
+			    GAsyncReadyCallback callback)
+{
+	if (state->proxy != NULL) {
+		g_dbus_proxy_call (state->proxy, method_name,
+				   parameters,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				   state->cancellable,
+				   callback,
+				   state);
+		return;
+	}
+	g_dbus_connection_call (state->client->priv->connection,
+				PK_DBUS_SERVICE,
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				method_name,
+				parameters,
+				NULL,
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				state);
+}
+
+/**
+ * pk_client_transaction_call_finish:
+ **/
+static GVariant *
+pk_client_transaction_call_finish (GObject *source_object,
+				   GAsyncResult *res,
+				   GError **error)
+{
+	if (G_IS_DBUS_PROXY (source_object)) {
+		return g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object),
+						 res, error);
+	}
+	return g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+					      res, error);
+}
+
 /**
  * pk_client_method_cb:
  **/
@@ -1431,13 +1838,12 @@ pk_client_method_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
 	PkClientState *state = (PkClientState *) user_data;
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_variant_unref_ GVariant *value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = pk_client_transaction_call_finish (source_object, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1466,6 +1872,209 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 	return;
 }
 
+/**
+ * pk_client_create_results:
+ **/
+static void
+pk_client_create_results (PkClientState *state)
+{
+	state->results = pk_results_new ();
+	g_object_set (state->results,
+		      "role", state->role,
+		      "progress", state->progress,
+		      "transaction-flags", state->transaction_flags,
+		      NULL);
+
+	/* the number of items the caller asked about */
+	switch (state->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+		g_object_set (state->results,
+			      "inputs", g_strv_length (state->package_ids),
+			      NULL);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+	case PK_ROLE_ENUM_INSTALL_FILES:
+		g_object_set (state->results,
+			      "inputs", g_strv_length (state->files),
+			      NULL);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * pk_client_get_role_method:
+ *
+ * Return value: the transaction method name for the role, with the
+ * method parameters returned as a floating variant.
+ **/
+static const gchar *
+pk_client_get_role_method (PkClientState *state, GVariant **parameters)
+{
+	switch (state->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->package_ids);
+		return "Resolve";
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchNames";
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchDetails";
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchGroups";
+	case PK_ROLE_ENUM_SEARCH_FILE:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "SearchFiles";
+	case PK_ROLE_ENUM_GET_DETAILS:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetDetails";
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
+		return "GetDetailsLocal";
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->files);
+		return "GetFilesLocal";
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetUpdateDetail";
+	case PK_ROLE_ENUM_GET_OLD_TRANSACTIONS:
+		*parameters = g_variant_new ("(u)",
+					     state->number);
+		return "GetOldTransactions";
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+		*parameters = g_variant_new ("(b^a&s)",
+					     (state->directory == NULL),
+					     state->package_ids);
+		return "DownloadPackages";
+	case PK_ROLE_ENUM_GET_UPDATES:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetUpdates";
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
+		return "DependsOn";
+	case PK_ROLE_ENUM_REQUIRED_BY:
+		*parameters = g_variant_new ("(t^a&sb)",
+					     state->filters,
+					     state->package_ids,
+					     state->recursive);
+		return "RequiredBy";
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetPackages";
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->filters,
+					     state->search);
+		return "WhatProvides";
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+		*parameters = g_variant_new ("()");
+		return "GetDistroUpgrades";
+	case PK_ROLE_ENUM_GET_FILES:
+		*parameters = g_variant_new ("(^a&s)",
+					     state->package_ids);
+		return "GetFiles";
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+		*parameters = g_variant_new ("()");
+		return "GetCategories";
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+		*parameters = g_variant_new ("(t^a&sbb)",
+					     state->transaction_flags,
+					     state->package_ids,
+					     state->allow_deps,
+					     state->autoremove);
+		return "RemovePackages";
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+		*parameters = g_variant_new ("(b)",
+					     state->force);
+		return "RefreshCache";
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
+		return "InstallPackages";
+	case PK_ROLE_ENUM_INSTALL_SIGNATURE:
+		*parameters = g_variant_new ("(uss)",
+					     state->type,
+					     state->key_id,
+					     state->package_id);
+		return "InstallSignature";
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->package_ids);
+		return "UpdatePackages";
+	case PK_ROLE_ENUM_INSTALL_FILES:
+		*parameters = g_variant_new ("(t^a&s)",
+					     state->transaction_flags,
+					     state->files);
+		return "InstallFiles";
+	case PK_ROLE_ENUM_ACCEPT_EULA:
+		*parameters = g_variant_new ("(s)",
+					     state->eula_id);
+		return "AcceptEula";
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+		*parameters = g_variant_new ("(t)",
+					     state->filters);
+		return "GetRepoList";
+	case PK_ROLE_ENUM_REPO_ENABLE:
+		*parameters = g_variant_new ("(sb)",
+					     state->repo_id,
+					     state->enabled);
+		return "RepoEnable";
+	case PK_ROLE_ENUM_REPO_SET_DATA:
+		*parameters = g_variant_new ("(sss)",
+					     state->repo_id,
+					     state->parameter ? state->parameter : "",
+					     state->value ? state->value : "");
+		return "RepoSetData";
+	case PK_ROLE_ENUM_REPO_REMOVE:
+		*parameters = g_variant_new ("(tsb)",
+					     state->transaction_flags,
+					     state->repo_id,
+					     state->autoremove);
+		return "RepoRemove";
+	case PK_ROLE_ENUM_REPAIR_SYSTEM:
+		*parameters = g_variant_new ("(t)",
+					     state->transaction_flags);
+		return "RepairSystem";
+	default:
+		g_assert_not_reached ();
+	}
+	return NULL;
+}
+
 /**
  * pk_client_set_hints_cb:
  **/
@@ -1474,13 +2083,14 @@ pk_client_set_hints_cb (GObject *source_object,
 			GAsyncResult *res,
 			gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	const gchar *method_name;
+	GVariant *parameters = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_variant_unref_ GVariant *value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = pk_client_transaction_call_finish (source_object, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1489,358 +2099,12 @@ pk_client_set_hints_cb (GObject *source_object,
 	}
 
 	/* we'll have results from now on */
-	state->results = pk_results_new ();
-	g_object_set (state->results,
-		      "role", state->role,
-		      "progress", state->progress,
-		      "transaction-flags", state->transaction_flags,
-		      NULL);
+	pk_client_create_results (state);
 
 	/* do this async, although this should be pretty fast anyway */
-	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-
-	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->package_ids),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-		g_object_set (state->results,
-			      "inputs", g_strv_length (state->files),
-			      NULL);
-	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
-	} else {
-		g_assert_not_reached ();
-	}
+	method_name = pk_client_get_role_method (state, &parameters);
+	pk_client_transaction_call (state, method_name, parameters,
+				    pk_client_method_cb);
 }
 
 /**
@@ -1987,26 +2251,26 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /**
- * pk_client_get_proxy_cb:
+ * pk_client_role_needs_helper:
  **/
-static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+static gboolean
+pk_client_role_needs_helper (PkRoleEnum role)
 {
-	gchar *hint;
-	PkClientState *state = (PkClientState *) user_data;
-	_cleanup_error_free_ GError *error = NULL;
-	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
-
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
+	return role == PK_ROLE_ENUM_INSTALL_FILES ||
+	       role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	       role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	       role == PK_ROLE_ENUM_UPDATE_PACKAGES;
+}
 
-	/* connect */
-	pk_client_proxy_connect (state);
+/**
+ * pk_client_get_hints:
+ **/
+static GPtrArray *
+pk_client_get_hints (PkClientState *state)
+{
+	gchar *hint;
+	GPtrArray *array;
 
-	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
 
 	/* locale */
@@ -2031,12 +2295,23 @@ pk_client_get_proxy_cb (GObject *object,
 					state->client->priv->cache_age);
 		g_ptr_array_add (array, hint);
 	}
+	return array;
+}
+
+/**
+ * pk_client_set_hints:
+ **/
+static void
+pk_client_set_hints (PkClientState *state)
+{
+	gchar *hint;
+	_cleanup_ptrarray_unref_ GPtrArray *array = NULL;
+
+	/* get hints */
+	array = pk_client_get_hints (state);
 
 	/* create socket for roles that need interaction */
-	if (state->role == PK_ROLE_ENUM_INSTALL_FILES ||
-	    state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
-	    state->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
-	    state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
+	if (pk_client_role_needs_helper (state->role)) {
 		hint = pk_client_create_helper_socket (state);
 		if (hint != NULL)
 			g_ptr_array_add (array, hint);
@@ -2044,14 +2319,29 @@ pk_client_get_proxy_cb (GObject *object,
 
 	/* set hints */
 	g_ptr_array_add (array, NULL);
-	g_dbus_proxy_call (state->proxy, "SetHints",
-			   g_variant_new ("(^a&s)",
-					  array->pdata),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   state->cancellable,
-			   pk_client_set_hints_cb,
-			   state);
+	pk_client_transaction_call (state, "SetHints",
+				    g_variant_new ("(^a&s)", array->pdata),
+				    pk_client_set_hints_cb);
+}
+
+/**
+ * pk_client_get_proxy_cb:
+ **/
+static void
+pk_client_get_proxy_cb (GObject *object,
+			GAsyncResult *res,
+			gpointer user_data)
+{
+	PkClientState *state = (PkClientState *) user_data;
+	_cleanup_error_free_ GError *error = NULL;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL)
+		g_error ("Cannot connect to PackageKit on %s", state->tid);
+
+	/* connect */
+	pk_client_proxy_connect (state);
+	pk_client_set_hints (state);
 
 	/* track state */
 	g_ptr_array_add (state->client->priv->calls, state);
@@ -2074,6 +2364,18 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
+	/* a new transaction has nothing worth preloading, so just listen
+	 * for the signals and PropertiesChanged deltas */
+	if (!state->client->priv->legacy_daemon &&
+	    state->client->priv->connection != NULL) {
+		state->use_connection_signals = TRUE;
+		state->own_signals = TRUE;
+		pk_client_state_add (state->client, state);
+		pk_client_state_subscribe_signals (state);
+		pk_client_set_hints (state);
+		return;
+	}
+
 	/* get a connection to the transaction interface */
 	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
 				  G_DBUS_PROXY_FLAGS_NONE,
@@ -2086,6 +2388,156 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 				  state);
 }
 
+/**
+ * pk_client_create_transaction_and_run_cb:
+ **/
+static void
+pk_client_create_transaction_and_run_cb (GObject *object,
+					 GAsyncResult *res,
+					 PkClientState *state)
+{
+	PkControl *control = PK_CONTROL (object);
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_free_ gchar *tid = NULL;
+
+	g_ptr_array_remove (state->client->priv->pending, state);
+	state->tid = pk_control_create_transaction_and_run_finish (control, res, &error);
+	if (state->tid == NULL) {
+		pk_client_claim_signals (state->client, NULL);
+		pk_client_unsubscribe_signals (state->client);
+
+		/* the daemon is too old, so do it in three steps */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+			state->client->priv->legacy_daemon = TRUE;
+			g_clear_object (&state->results);
+			pk_control_get_tid_async (control,
+						  state->cancellable_client,
+						  (GAsyncReadyCallback) pk_client_get_tid_cb,
+						  state);
+			return;
+		}
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	pk_progress_set_transaction_id (state->progress, state->tid);
+
+	/* the daemon has already started the role, so stop it there too */
+	if (state->cancellable_client != NULL &&
+	    g_cancellable_set_error_if_cancelled (state->cancellable_client, &error)) {
+		g_debug ("cancelling %s", state->tid);
+		g_dbus_connection_call (state->client->priv->connection,
+					PK_DBUS_SERVICE,
+					state->tid,
+					PK_DBUS_INTERFACE_TRANSACTION,
+					"Cancel",
+					NULL,
+					NULL,
+					G_DBUS_CALL_FLAGS_NONE,
+					PK_CLIENT_DBUS_METHOD_TIMEOUT,
+					NULL, NULL, NULL);
+		pk_client_claim_signals (state->client, NULL);
+		pk_client_unsubscribe_signals (state->client);
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* track state */
+	state->use_connection_signals = TRUE;
+	pk_client_state_add (state->client, state);
+	pk_client_state_subscribe_signals (state);
+	pk_client_state_handover (state);
+
+	/* catch up, which may finish the state */
+	tid = g_strdup (state->tid);
+	pk_client_claim_signals (state->client, tid);
+}
+
+/**
+ * pk_client_bus_get_cb:
+ **/
+static void
+pk_client_bus_get_cb (GObject *source_object, GAsyncResult *res, PkClientState *state)
+{
+	PkClientPrivate *priv = state->client->priv;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_object_unref_ GDBusConnection *connection = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (connection == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			pk_client_state_finish (state, error);
+			return;
+		}
+
+		/* the proxies get their own connection */
+		g_debug ("failed to get the system bus: %s", error->message);
+		pk_control_get_tid_async (priv->control,
+					  state->cancellable_client,
+					  (GAsyncReadyCallback) pk_client_get_tid_cb,
+					  state);
+		return;
+	}
+
+	/* another request may have been quicker */
+	if (priv->connection == NULL)
+		priv->connection = g_object_ref (connection);
+	pk_client_create_transaction (state, state->cancellable_client);
+}
+
+/**
+ * pk_client_create_transaction:
+ *
+ * Creates the transaction and starts the role method, using one D-Bus
+ * call if the daemon supports it.
+ **/
+static void
+pk_client_create_transaction (PkClientState *state, GCancellable *cancellable)
+{
+	const gchar *method_name;
+	GVariant *parameters = NULL;
+	PkClient *client = state->client;
+	_cleanup_ptrarray_unref_ GPtrArray *hints = NULL;
+
+	/* the frontend socket is named after the tid so needs SetHints */
+	if (client->priv->legacy_daemon ||
+	    pk_client_role_needs_helper (state->role)) {
+		pk_control_get_tid_async (client->priv->control,
+					  cancellable,
+					  (GAsyncReadyCallback) pk_client_get_tid_cb,
+					  state);
+		return;
+	}
+
+	/* the signals are matched on our own connection */
+	if (client->priv->connection == NULL) {
+		g_bus_get (G_BUS_TYPE_SYSTEM,
+			   cancellable,
+			   (GAsyncReadyCallback) pk_client_bus_get_cb,
+			   state);
+		return;
+	}
+
+	/* signals can be replayed as soon as we have the tid */
+	pk_client_subscribe_signals (client);
+	pk_client_create_results (state);
+	hints = pk_client_get_hints (state);
+	g_ptr_array_add (hints, NULL);
+	method_name = pk_client_get_role_method (state, &parameters);
+	state->create_time = g_get_monotonic_time ();
+	g_ptr_array_add (client->priv->pending, state);
+
+	/* not cancellable, as the daemon may start the role anyway: the
+	 * reply cancels it there if the caller has given up meanwhile */
+	pk_control_create_transaction_and_run_async (client->priv->control,
+						     (gchar **) hints->pdata,
+						     method_name,
+						     parameters,
+						     NULL,
+						     (GAsyncReadyCallback) pk_client_create_transaction_and_run_cb,
+						     state);
+}
+
 /**
  * pk_client_generic_finish:
  * @client: a valid #PkClient instance
@@ -2176,10 +2628,7 @@ pk_client_resolve_async (PkClient *client, PkBitfield filters, gchar **packages,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2243,10 +2692,7 @@ pk_client_search_names_async (PkClient *client, PkBitfield filters, gchar **valu
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2311,10 +2757,7 @@ pk_client_search_details_async (PkClient *client, PkBitfield filters, gchar **va
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2377,10 +2820,7 @@ pk_client_search_groups_async (PkClient *client, PkBitfield filters, gchar **val
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2443,10 +2883,7 @@ pk_client_search_files_async (PkClient *client, PkBitfield filters, gchar **valu
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2509,10 +2946,7 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2579,10 +3013,7 @@ pk_client_get_details_local_async (PkClient *client, gchar **files, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2649,10 +3080,7 @@ pk_client_get_files_local_async (PkClient *client, gchar **files, GCancellable *
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2715,10 +3143,7 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2782,10 +3207,7 @@ pk_client_download_packages_async (PkClient *client, gchar **package_ids, const
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2846,10 +3268,7 @@ pk_client_get_updates_async (PkClient *client, PkBitfield filters, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2910,10 +3329,7 @@ pk_client_get_old_transactions_async (PkClient *client, guint number, GCancellab
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -2979,10 +3395,7 @@ pk_client_depends_on_async (PkClient *client, PkBitfield filters, gchar **packag
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3043,10 +3456,7 @@ pk_client_get_packages_async (PkClient *client, PkBitfield filters, GCancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3112,10 +3522,7 @@ pk_client_required_by_async (PkClient *client, PkBitfield filters, gchar **packa
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3183,10 +3590,7 @@ pk_client_what_provides_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3246,10 +3650,7 @@ pk_client_get_distro_upgrades_async (PkClient *client, GCancellable *cancellable
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3311,10 +3712,7 @@ pk_client_get_files_async (PkClient *client, gchar **package_ids, GCancellable *
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3373,10 +3771,7 @@ pk_client_get_categories_async (PkClient *client, GCancellable *cancellable,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3453,10 +3848,7 @@ pk_client_remove_packages_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3520,10 +3912,7 @@ pk_client_refresh_cache_async (PkClient *client, gboolean force, GCancellable *c
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3587,10 +3976,7 @@ pk_client_install_packages_async (PkClient *client, PkBitfield transaction_flags
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3655,10 +4041,7 @@ pk_client_install_signature_async (PkClient *client, PkSigTypeEnum type, const g
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3727,10 +4110,7 @@ pk_client_update_packages_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -3750,10 +4130,7 @@ pk_client_copy_native_finished_cb (GFile *file, GAsyncResult *res, PkClientState
 	/* no more copies pending? */
 	if (--state->refcount == 0) {
 		/* now get tid and continue on our merry way */
-		pk_control_get_tid_async (state->client->priv->control,
-					  state->cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  state);
+		pk_client_create_transaction (state, state->cancellable);
 	}
 }
 
@@ -3893,10 +4270,7 @@ pk_client_install_files_async (PkClient *client,
 	/* nothing to copy, common case */
 	if (state->refcount == 0) {
 		/* just get tid */
-		pk_control_get_tid_async (client->priv->control,
-					  cancellable,
-					  (GAsyncReadyCallback) pk_client_get_tid_cb,
-					  state);
+		pk_client_create_transaction (state, cancellable);
 		return;
 	}
 
@@ -3962,10 +4336,7 @@ pk_client_accept_eula_async (PkClient *client, const gchar *eula_id, GCancellabl
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4026,10 +4397,7 @@ pk_client_get_repo_list_async (PkClient *client, PkBitfield filters, GCancellabl
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4092,10 +4460,7 @@ pk_client_repo_enable_async (PkClient *client, const gchar *repo_id, gboolean en
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4161,10 +4526,7 @@ pk_client_repo_set_data_async (PkClient *client, const gchar *repo_id, const gch
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4235,10 +4597,7 @@ pk_client_repo_remove_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control,
-				  cancellable,
-				  (GAsyncReadyCallback) pk_client_get_tid_cb,
-				  state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**
@@ -4303,7 +4662,7 @@ pk_client_repair_system_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 
 	/* get tid */
-	pk_control_get_tid_async (client->priv->control, cancellable, (GAsyncReadyCallback) pk_client_get_tid_cb, state);
+	pk_client_create_transaction (state, cancellable);
 }
 
 /**********************************************************************/
@@ -4598,7 +4957,7 @@ pk_client_cancel_all_dbus_methods (PkClient *client)
 	array = client->priv->calls;
 	for (i = 0; i < array->len; i++) {
 		state = g_ptr_array_index (array, i);
-		if (state->proxy == NULL)
+		if (state->proxy == NULL && !state->use_connection_signals)
 			continue;
 		g_debug ("cancel in flight call");
 		g_cancellable_cancel (state->cancellable);
@@ -4730,6 +5089,19 @@ pk_client_get_idle (PkClient *client)
 	return client->priv->idle;
 }
 
+/**
+ * pk_client_get_legacy_daemon:
+ *
+ * Gets if the client fell back to CreateTransaction and SetHints
+ * because the daemon could not create and run in one call.
+ **/
+gboolean
+pk_client_get_legacy_daemon (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), FALSE);
+	return client->priv->legacy_daemon;
+}
+
 /**
  * pk_client_set_cache_age:
  * @client: a valid #PkClient instance
@@ -4837,6 +5209,8 @@ pk_client_init (PkClient *client)
 {
 	client->priv = PK_CLIENT_GET_PRIVATE (client);
 	client->priv->calls = g_ptr_array_new ();
+	client->priv->pending = g_ptr_array_new ();
+	client->priv->unclaimed = g_queue_new ();
 	client->priv->background = FALSE;
 	client->priv->interactive = TRUE;
 	client->priv->idle = TRUE;
@@ -4861,9 +5235,20 @@ pk_client_finalize (GObject *object)
 	/* ensure we cancel any in-flight DBus calls */
 	pk_client_cancel_all_dbus_methods (client);
 
+	if (priv->transaction_signal_id != 0) {
+		g_dbus_connection_signal_unsubscribe (priv->connection,
+						      priv->transaction_signal_id);
+		g_dbus_connection_signal_unsubscribe (priv->connection,
+						      priv->properties_changed_id);
+	}
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
+
 	g_free (client->priv->locale);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
+	g_ptr_array_unref (priv->pending);
+	g_queue_free_full (priv->unclaimed, (GDestroyNotify) pk_client_signal_free);
 
 	G_OBJECT_CLASS (pk_client_parent_class)->finalize (object);
 }
@@ -37,6 +37,7 @@
 #include <packagekit-glib2/pk-bitfield.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-control.h>
+#include <packagekit-glib2/pk-control-private.h>
 #include <packagekit-glib2/pk-version.h>
 
 static void     pk_control_finalize	(GObject     *object);
@@ -70,6 +71,7 @@ struct _PkControlPrivate
 	gboolean		 locked;
 	PkNetworkEnum		 network_state;
 	gchar			*distro_id;
+	gboolean		 can_create_transaction_and_run;
 	guint			 transaction_list_changed_id;
 	guint			 restart_schedule_id;
 	guint			 updates_changed_id;
@@ -316,6 +318,10 @@ pk_control_set_property_value (PkControl *control,
 		g_object_notify (G_OBJECT(control), "distro-id");
 		return;
 	}
+	if (g_strcmp0 (key, "CanCreateTransactionAndRun") == 0) {
+		control->priv->can_create_transaction_and_run = g_variant_get_boolean (value);
+		return;
+	}
 	g_warning ("unhandled property '%s'", key);
 }
 
@@ -620,6 +626,254 @@ pk_control_get_tid_finish (PkControl *control,
 
 /**********************************************************************/
 
+/**
+ * pk_control_create_transaction_and_run_state_finish:
+ **/
+static void
+pk_control_create_transaction_and_run_state_finish (PkControlState *state,
+						    const GError *error)
+{
+	/* get result */
+	if (state->tid != NULL) {
+		g_simple_async_result_set_op_res_gpointer (state->res,
+							   g_strdup (state->tid),
+							   g_free);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	g_free (state->tid);
+	g_variant_unref (state->parameters);
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_slice_free (PkControlState, state);
+}
+
+/**
+ * pk_control_create_transaction_and_run_cb:
+ **/
+static void
+pk_control_create_transaction_and_run_cb (GObject *source_object,
+					  GAsyncResult *res,
+					  gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_variant_unref_ GVariant *value = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_create_transaction_and_run_state_finish (state, error);
+		return;
+	}
+
+	/* save results */
+	g_variant_get (value, "(o)", &state->tid);
+
+	/* we're done */
+	pk_control_create_transaction_and_run_state_finish (state, NULL);
+}
+
+/**
+ * pk_control_create_transaction_and_run_internal:
+ **/
+static void
+pk_control_create_transaction_and_run_internal (PkControlState *state)
+{
+	_cleanup_error_free_ GError *error = NULL;
+
+	/* older daemons need CreateTransaction, SetHints and the role method */
+	if (!state->control->priv->can_create_transaction_and_run) {
+		g_set_error_literal (&error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_NOT_SUPPORTED,
+				     "daemon does not support CreateTransactionAndRun");
+		pk_control_create_transaction_and_run_state_finish (state, error);
+		return;
+	}
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "CreateTransactionAndRun",
+			   state->parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   state->cancellable,
+			   pk_control_create_transaction_and_run_cb,
+			   state);
+}
+
+/**
+ * pk_control_create_transaction_and_run_proxy_cb:
+ **/
+static void
+pk_control_create_transaction_and_run_proxy_cb (GObject *source_object,
+						GAsyncResult *res,
+						gpointer user_data)
+{
+	_cleanup_error_free_ GError *error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_create_transaction_and_run_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_create_transaction_and_run_internal (state);
+}
+
+/**
+ * pk_control_create_transaction_and_run_async:
+ * @control: a valid #PkControl instance
+ * @hints: (array zero-terminated=1): the transaction hints, e.g. "locale=en_GB.utf8"
+ * @method_name: the transaction role method to call, e.g. "Resolve"
+ * @parameters: the parameters for @method_name
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Creates a transaction, sets the hints and calls the role method, all in
+ * one D-Bus method call. The caller has to be listening for the
+ * transaction signals before calling this, as they may be emitted before
+ * the transaction ID is returned.
+ *
+ * If the daemon does not support this then the operation fails with
+ * %G_IO_ERROR_NOT_SUPPORTED and pk_control_get_tid_async() should be used
+ * instead.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_control_create_transaction_and_run_async (PkControl *control,
+					     gchar **hints,
+					     const gchar *method_name,
+					     GVariant *parameters,
+					     GCancellable *cancellable,
+					     GAsyncReadyCallback callback,
+					     gpointer user_data)
+{
+	const gchar *hints_empty[] = { NULL };
+	PkControlState *state;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_object_unref_ GSimpleAsyncResult *res = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (method_name != NULL);
+	g_return_if_fail (parameters != NULL);
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_create_transaction_and_run_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	state->parameters = g_variant_new ("(^as&sv)",
+					   hints != NULL ? (const gchar **) hints : hints_empty,
+					   method_name,
+					   parameters);
+	g_variant_ref_sink (state->parameters);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_create_transaction_and_run_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_create_transaction_and_run_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_create_transaction_and_run_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_create_transaction_and_run_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: the transaction ID, or %NULL if unset, free with g_free()
+ *
+ * Since: 1.0.0
+ **/
+gchar *
+pk_control_create_transaction_and_run_finish (PkControl *control,
+					      GAsyncResult *res,
+					      GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_create_transaction_and_run_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/**
+ * pk_control_set_can_create_transaction_and_run:
+ *
+ * Overrides what the daemon reported, so the self tests can check the
+ * fallback used with older daemons.
+ **/
+void
+pk_control_set_can_create_transaction_and_run (PkControl *control,
+					       gboolean can_create_transaction_and_run)
+{
+	g_return_if_fail (PK_IS_CONTROL (control));
+	control->priv->can_create_transaction_and_run = can_create_transaction_and_run;
+}
+
+/**********************************************************************/
+
 
 /**
  * pk_control_suggest_daemon_quit_state_finish:
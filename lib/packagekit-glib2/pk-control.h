@@ -99,6 +99,16 @@ void		 pk_control_get_tid_async		(PkControl		*control,
 gchar		*pk_control_get_tid_finish		(PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_create_transaction_and_run_async (PkControl		*control,
+							 gchar			**hints,
+							 const gchar		*method_name,
+							 GVariant		*parameters,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gchar		*pk_control_create_transaction_and_run_finish (PkControl		*control,
+							 GAsyncResult		*res,
+							 GError			**error);
 void		 pk_control_suggest_daemon_quit_async	(PkControl		*control,
 							 GCancellable		*cancellable,
 							 GAsyncReadyCallback	 callback,
@@ -0,0 +1,120 @@
+#!/usr/bin/python
+# -*- Mode: Python; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+#
+# Copyright (C) 2026 agent <agent@local>
+#
+# Licensed under the GNU Lesser General Public License Version 2.1
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+
+"""
+Generates string-to-index lookup functions for the PkEnumMatch tables in
+pk-enum.c, so that the *_enum_from_string() functions do not have to walk
+the whole table with strcmp().
+
+Each generated function switches on the string length and then on the
+first differing character, and only then compares the remaining bytes.
+
+Usage: pk-enum-lookup.py pk-enum.c > pk-enum-lookup.h
+"""
+
+import re
+import sys
+
+TABLE_RE = re.compile(r'static const PkEnumMatch (\w+)\[\] = \{(.*?)\n\};', re.S)
+ENTRY_RE = re.compile(r'\{\s*\w+\s*,\s*"([^"]*)"\s*\}')
+
+def _c_char(char):
+    if char == "'" or char == '\\':
+        return "'\\%s'" % char
+    return "'%s'" % char
+
+def _pivot(strings):
+    """ find the first position that differs between the strings """
+    for pos in range(len(strings[0][0])):
+        if len(set(s[pos] for s, _ in strings)) > 1:
+            return pos
+    return 0
+
+def _emit_group(out, strings, length, indent):
+    """ emit a switch that narrows the candidates down to a single compare """
+    tab = '\t' * indent
+    if len(strings) == 1:
+        string, idx = strings[0]
+        out.append('%sif (memcmp (str, "%s", %i) == 0)' % (tab, string, length))
+        out.append('%s\treturn %i;' % (tab, idx))
+        return
+    pos = _pivot(strings)
+    buckets = {}
+    for string, idx in strings:
+        buckets.setdefault(string[pos], []).append((string, idx))
+    out.append('%sswitch (str[%i]) {' % (tab, pos))
+    for char in sorted(buckets):
+        out.append('%scase %s:' % (tab, _c_char(char)))
+        _emit_group(out, buckets[char], length, indent + 1)
+        out.append('%s\tbreak;' % tab)
+    out.append('%sdefault:' % tab)
+    out.append('%s\tbreak;' % tab)
+    out.append('%s}' % tab)
+
+def _emit_table(out, table, body):
+    name = table[len('enum_'):] if table.startswith('enum_') else table
+    strings = []
+    seen = set()
+    for idx, string in enumerate(ENTRY_RE.findall(body)):
+        # the linear search returned the first match
+        if string in seen:
+            continue
+        seen.add(string)
+        strings.append((string, idx))
+
+    by_length = {}
+    for string, idx in strings:
+        by_length.setdefault(len(string), []).append((string, idx))
+
+    out.append('/**')
+    out.append(' * pk_enum_lookup_%s:' % name)
+    out.append(' **/')
+    out.append('static gint')
+    out.append('pk_enum_lookup_%s (const gchar *str)' % name)
+    out.append('{')
+    out.append('\tswitch (strlen (str)) {')
+    for length in sorted(by_length):
+        out.append('\tcase %i:' % length)
+        _emit_group(out, by_length[length], length, 2)
+        out.append('\t\tbreak;')
+    out.append('\tdefault:')
+    out.append('\t\tbreak;')
+    out.append('\t}')
+    out.append('\treturn -1;')
+    out.append('}')
+    out.append('')
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write('usage: %s pk-enum.c\n' % sys.argv[0])
+        sys.exit(1)
+    with open(sys.argv[1]) as f:
+        data = f.read()
+
+    out = []
+    out.append('/* Generated by pk-enum-lookup.py from pk-enum.c -- do not edit */')
+    out.append('')
+    for name, body in TABLE_RE.findall(data):
+        _emit_table(out, name, body)
+    sys.stdout.write('\n'.join(out))
+
+if __name__ == '__main__':
+    main()
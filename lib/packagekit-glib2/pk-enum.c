@@ -374,6 +374,27 @@ static const PkEnumMatch enum_transaction_flag[] = {
 	{0, NULL}
 };
 
+/* pk_enum_lookup_*() functions generated from the tables above */
+#include "pk-enum-lookup.h"
+
+/**
+ * pk_enum_find_index:
+ **/
+static guint
+pk_enum_find_index (const PkEnumMatch *table, const gchar *string,
+		    gint (*lookup) (const gchar *str))
+{
+	gint idx;
+
+	/* return the first entry on non-found or error */
+	if (string == NULL)
+		return table[0].value;
+	idx = lookup (string);
+	if (idx < 0)
+		return table[0].value;
+	return table[idx].value;
+}
+
 /**
  * pk_enum_find_value:
  * @table: A #PkEnumMatch enum table of values
@@ -442,7 +463,7 @@ pk_enum_find_string (const PkEnumMatch *table, guint value)
 PkSigTypeEnum
 pk_sig_type_enum_from_string (const gchar *sig_type)
 {
-	return pk_enum_find_value (enum_sig_type, sig_type);
+	return pk_enum_find_index (enum_sig_type, sig_type, pk_enum_lookup_sig_type);
 }
 
 /**
@@ -474,7 +495,7 @@ pk_sig_type_enum_to_string (PkSigTypeEnum sig_type)
 PkDistroUpgradeEnum
 pk_distro_upgrade_enum_from_string (const gchar *upgrade)
 {
-	return pk_enum_find_value (enum_upgrade, upgrade);
+	return pk_enum_find_index (enum_upgrade, upgrade, pk_enum_lookup_upgrade);
 }
 
 /**
@@ -506,7 +527,7 @@ pk_distro_upgrade_enum_to_string (PkDistroUpgradeEnum upgrade)
 PkInfoEnum
 pk_info_enum_from_string (const gchar *info)
 {
-	return pk_enum_find_value (enum_info, info);
+	return pk_enum_find_index (enum_info, info, pk_enum_lookup_info);
 }
 
 /**
@@ -538,7 +559,7 @@ pk_info_enum_to_string (PkInfoEnum info)
 PkExitEnum
 pk_exit_enum_from_string (const gchar *exit_text)
 {
-	return pk_enum_find_value (enum_exit, exit_text);
+	return pk_enum_find_index (enum_exit, exit_text, pk_enum_lookup_exit);
 }
 
 /**
@@ -570,7 +591,7 @@ pk_exit_enum_to_string (PkExitEnum exit_enum)
 PkNetworkEnum
 pk_network_enum_from_string (const gchar *network)
 {
-	return pk_enum_find_value (enum_network, network);
+	return pk_enum_find_index (enum_network, network, pk_enum_lookup_network);
 }
 
 /**
@@ -602,7 +623,7 @@ pk_network_enum_to_string (PkNetworkEnum network)
 PkStatusEnum
 pk_status_enum_from_string (const gchar *status)
 {
-	return pk_enum_find_value (enum_status, status);
+	return pk_enum_find_index (enum_status, status, pk_enum_lookup_status);
 }
 
 /**
@@ -634,7 +655,7 @@ pk_status_enum_to_string (PkStatusEnum status)
 PkRoleEnum
 pk_role_enum_from_string (const gchar *role)
 {
-	return pk_enum_find_value (enum_role, role);
+	return pk_enum_find_index (enum_role, role, pk_enum_lookup_role);
 }
 
 /**
@@ -666,7 +687,7 @@ pk_role_enum_to_string (PkRoleEnum role)
 PkErrorEnum
 pk_error_enum_from_string (const gchar *code)
 {
-	return pk_enum_find_value (enum_error, code);
+	return pk_enum_find_index (enum_error, code, pk_enum_lookup_error);
 }
 
 /**
@@ -698,7 +719,7 @@ pk_error_enum_to_string (PkErrorEnum code)
 PkRestartEnum
 pk_restart_enum_from_string (const gchar *restart)
 {
-	return pk_enum_find_value (enum_restart, restart);
+	return pk_enum_find_index (enum_restart, restart, pk_enum_lookup_restart);
 }
 
 /**
@@ -730,7 +751,7 @@ pk_restart_enum_to_string (PkRestartEnum restart)
 PkGroupEnum
 pk_group_enum_from_string (const gchar *group)
 {
-	return pk_enum_find_value (enum_group, group);
+	return pk_enum_find_index (enum_group, group, pk_enum_lookup_group);
 }
 
 /**
@@ -762,7 +783,7 @@ pk_group_enum_to_string (PkGroupEnum group)
 PkUpdateStateEnum
 pk_update_state_enum_from_string (const gchar *update_state)
 {
-	return pk_enum_find_value (enum_update_state, update_state);
+	return pk_enum_find_index (enum_update_state, update_state, pk_enum_lookup_update_state);
 }
 
 /**
@@ -794,7 +815,7 @@ pk_update_state_enum_to_string (PkUpdateStateEnum update_state)
 PkFilterEnum
 pk_filter_enum_from_string (const gchar *filter)
 {
-	return pk_enum_find_value (enum_filter, filter);
+	return pk_enum_find_index (enum_filter, filter, pk_enum_lookup_filter);
 }
 
 /**
@@ -826,7 +847,7 @@ pk_filter_enum_to_string (PkFilterEnum filter)
 PkMediaTypeEnum
 pk_media_type_enum_from_string (const gchar *media_type)
 {
-	return pk_enum_find_value (enum_media_type, media_type);
+	return pk_enum_find_index (enum_media_type, media_type, pk_enum_lookup_media_type);
 }
 
 /**
@@ -858,7 +879,7 @@ pk_media_type_enum_to_string (PkMediaTypeEnum media_type)
 PkAuthorizeEnum
 pk_authorize_type_enum_from_string (const gchar *authorize_type)
 {
-	return pk_enum_find_value (enum_authorize_type, authorize_type);
+	return pk_enum_find_index (enum_authorize_type, authorize_type, pk_enum_lookup_authorize_type);
 }
 
 /**
@@ -890,7 +911,7 @@ pk_authorize_type_enum_to_string (PkAuthorizeEnum authorize_type)
 PkUpgradeKindEnum
 pk_upgrade_kind_enum_from_string (const gchar *upgrade_kind)
 {
-	return pk_enum_find_value (enum_upgrade_kind, upgrade_kind);
+	return pk_enum_find_index (enum_upgrade_kind, upgrade_kind, pk_enum_lookup_upgrade_kind);
 }
 
 /**
@@ -922,7 +943,7 @@ pk_upgrade_kind_enum_to_string (PkUpgradeKindEnum upgrade_kind)
 PkTransactionFlagEnum
 pk_transaction_flag_enum_from_string (const gchar *transaction_flag)
 {
-	return pk_enum_find_value (enum_transaction_flag, transaction_flag);
+	return pk_enum_find_index (enum_transaction_flag, transaction_flag, pk_enum_lookup_transaction_flag);
 }
 
 /**
@@ -0,0 +1,332 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:pk-package-id-set
+ * @short_description: An ordered set of PackageIDs
+ *
+ * Unlike the pk_package_ids_*() functions which scan and copy a string
+ * array for every operation, a #PkPackageIdSet checks membership using a
+ * hash table, so adding, removing or looking up a PackageID is O(1).
+ * The order in which PackageIDs were first added is preserved.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include <packagekit-glib2/pk-package-id-set.h>
+
+struct _PkPackageIdSet {
+	GQueue		*queue;		/* of gchar*, owned */
+	GHashTable	*hash;		/* package_id:GList* into queue */
+	gint		 refcount;
+};
+
+G_DEFINE_BOXED_TYPE (PkPackageIdSet, pk_package_id_set,
+		     pk_package_id_set_ref, pk_package_id_set_unref)
+
+/**
+ * pk_package_id_set_new:
+ *
+ * Creates a new empty set.
+ *
+ * Return value: (transfer full): a new #PkPackageIdSet, free with pk_package_id_set_unref()
+ *
+ * Since: 1.0.0
+ **/
+PkPackageIdSet *
+pk_package_id_set_new (void)
+{
+	PkPackageIdSet *set;
+	set = g_slice_new0 (PkPackageIdSet);
+	set->queue = g_queue_new ();
+	set->hash = g_hash_table_new (g_str_hash, g_str_equal);
+	set->refcount = 1;
+	return set;
+}
+
+/**
+ * pk_package_id_set_new_from_strv:
+ * @package_ids: (array zero-terminated=1): a string array of package_id's
+ *
+ * Creates a new set from a string array, ignoring any duplicates.
+ *
+ * Return value: (transfer full): a new #PkPackageIdSet, free with pk_package_id_set_unref()
+ *
+ * Since: 1.0.0
+ **/
+PkPackageIdSet *
+pk_package_id_set_new_from_strv (gchar **package_ids)
+{
+	PkPackageIdSet *set;
+	set = pk_package_id_set_new ();
+	if (package_ids != NULL)
+		pk_package_id_set_add_strv (set, package_ids);
+	return set;
+}
+
+/**
+ * pk_package_id_set_ref:
+ * @set: a #PkPackageIdSet
+ *
+ * Increases the reference count of the set.
+ *
+ * Return value: (transfer full): @set
+ *
+ * Since: 1.0.0
+ **/
+PkPackageIdSet *
+pk_package_id_set_ref (PkPackageIdSet *set)
+{
+	g_return_val_if_fail (set != NULL, NULL);
+	g_atomic_int_inc (&set->refcount);
+	return set;
+}
+
+/**
+ * pk_package_id_set_unref:
+ * @set: a #PkPackageIdSet
+ *
+ * Decreases the reference count of the set, freeing it when it reaches zero.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_package_id_set_unref (PkPackageIdSet *set)
+{
+	g_return_if_fail (set != NULL);
+	if (!g_atomic_int_dec_and_test (&set->refcount))
+		return;
+	g_hash_table_unref (set->hash);
+	g_queue_free_full (set->queue, g_free);
+	g_slice_free (PkPackageIdSet, set);
+}
+
+/**
+ * pk_package_id_set_get_size:
+ * @set: a #PkPackageIdSet
+ *
+ * Return value: the number of PackageIDs in the set
+ *
+ * Since: 1.0.0
+ **/
+guint
+pk_package_id_set_get_size (PkPackageIdSet *set)
+{
+	g_return_val_if_fail (set != NULL, 0);
+	return g_queue_get_length (set->queue);
+}
+
+/**
+ * pk_package_id_set_contains:
+ * @set: a #PkPackageIdSet
+ * @package_id: a single package_id
+ *
+ * Finds out if a package ID is present in the set.
+ *
+ * Return value: %TRUE if the package ID is present
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_set_contains (PkPackageIdSet *set, const gchar *package_id)
+{
+	g_return_val_if_fail (set != NULL, FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+	return g_hash_table_contains (set->hash, package_id);
+}
+
+/**
+ * pk_package_id_set_add:
+ * @set: a #PkPackageIdSet
+ * @package_id: a single package_id
+ *
+ * Adds a package ID to the end of the set if it is not already present.
+ *
+ * Return value: %TRUE if the package ID was added
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_set_add (PkPackageIdSet *set, const gchar *package_id)
+{
+	gchar *tmp;
+
+	g_return_val_if_fail (set != NULL, FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+
+	if (g_hash_table_contains (set->hash, package_id))
+		return FALSE;
+	tmp = g_strdup (package_id);
+	g_queue_push_tail (set->queue, tmp);
+	g_hash_table_insert (set->hash, tmp, g_queue_peek_tail_link (set->queue));
+	return TRUE;
+}
+
+/**
+ * pk_package_id_set_add_strv:
+ * @set: a #PkPackageIdSet
+ * @package_ids: (array zero-terminated=1): a string array of package_id's
+ *
+ * Adds each package ID to the set, ignoring any that are already present.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_package_id_set_add_strv (PkPackageIdSet *set, gchar **package_ids)
+{
+	guint i;
+
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (package_ids != NULL);
+
+	for (i = 0; package_ids[i] != NULL; i++)
+		pk_package_id_set_add (set, package_ids[i]);
+}
+
+/**
+ * pk_package_id_set_remove:
+ * @set: a #PkPackageIdSet
+ * @package_id: a single package_id
+ *
+ * Removes a package ID from the set.
+ *
+ * Return value: %TRUE if the package ID was present
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_set_remove (PkPackageIdSet *set, const gchar *package_id)
+{
+	GList *link;
+
+	g_return_val_if_fail (set != NULL, FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+
+	link = g_hash_table_lookup (set->hash, package_id);
+	if (link == NULL)
+		return FALSE;
+	g_hash_table_remove (set->hash, package_id);
+	g_free (link->data);
+	g_queue_delete_link (set->queue, link);
+	return TRUE;
+}
+
+/**
+ * pk_package_id_set_union:
+ * @set: a #PkPackageIdSet
+ * @other: another #PkPackageIdSet
+ *
+ * Adds every package ID in @other to @set, keeping the order of @other
+ * for the package IDs that were not already present.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_package_id_set_union (PkPackageIdSet *set, PkPackageIdSet *other)
+{
+	GList *l;
+
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (other != NULL);
+
+	if (set == other)
+		return;
+	for (l = other->queue->head; l != NULL; l = l->next)
+		pk_package_id_set_add (set, l->data);
+}
+
+/**
+ * pk_package_id_set_difference:
+ * @set: a #PkPackageIdSet
+ * @other: another #PkPackageIdSet
+ *
+ * Removes every package ID in @other from @set.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_package_id_set_difference (PkPackageIdSet *set, PkPackageIdSet *other)
+{
+	GList *l;
+	GList *next;
+
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (other != NULL);
+
+	/* walk whichever set is smaller */
+	if (g_queue_get_length (other->queue) < g_queue_get_length (set->queue) &&
+	    set != other) {
+		for (l = other->queue->head; l != NULL; l = l->next)
+			pk_package_id_set_remove (set, l->data);
+		return;
+	}
+	for (l = set->queue->head; l != NULL; l = next) {
+		next = l->next;
+		if (g_hash_table_contains (other->hash, l->data))
+			pk_package_id_set_remove (set, l->data);
+	}
+}
+
+/**
+ * pk_package_id_set_foreach:
+ * @set: a #PkPackageIdSet
+ * @func: (scope call): the function to call with each package ID
+ * @user_data: user data to pass to @func
+ *
+ * Calls @func for each package ID in the order they were added. The set
+ * must not be modified from @func.
+ *
+ * Since: 1.0.0
+ **/
+void
+pk_package_id_set_foreach (PkPackageIdSet *set, GFunc func, gpointer user_data)
+{
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (func != NULL);
+	g_queue_foreach (set->queue, func, user_data);
+}
+
+/**
+ * pk_package_id_set_to_strv:
+ * @set: a #PkPackageIdSet
+ *
+ * Converts the set to a string array in the order the package IDs were added.
+ *
+ * Return value: (transfer full): the string array, free with g_strfreev()
+ *
+ * Since: 1.0.0
+ **/
+gchar **
+pk_package_id_set_to_strv (PkPackageIdSet *set)
+{
+	gchar **package_ids;
+	GList *l;
+	guint i = 0;
+
+	g_return_val_if_fail (set != NULL, NULL);
+
+	package_ids = g_new0 (gchar *, g_queue_get_length (set->queue) + 1);
+	for (l = set->queue->head; l != NULL; l = l->next)
+		package_ids[i++] = g_strdup (l->data);
+	return package_ids;
+}
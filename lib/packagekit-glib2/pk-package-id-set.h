@@ -0,0 +1,62 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_PACKAGE_ID_SET_H
+#define __PK_PACKAGE_ID_SET_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_PACKAGE_ID_SET	(pk_package_id_set_get_type ())
+
+typedef struct _PkPackageIdSet	PkPackageIdSet;
+
+GType		 pk_package_id_set_get_type		(void);
+PkPackageIdSet	*pk_package_id_set_new			(void);
+PkPackageIdSet	*pk_package_id_set_new_from_strv	(gchar		**package_ids);
+PkPackageIdSet	*pk_package_id_set_ref			(PkPackageIdSet	*set);
+void		 pk_package_id_set_unref		(PkPackageIdSet	*set);
+guint		 pk_package_id_set_get_size		(PkPackageIdSet	*set);
+gboolean	 pk_package_id_set_contains		(PkPackageIdSet	*set,
+							 const gchar	*package_id);
+gboolean	 pk_package_id_set_add			(PkPackageIdSet	*set,
+							 const gchar	*package_id);
+void		 pk_package_id_set_add_strv		(PkPackageIdSet	*set,
+							 gchar		**package_ids);
+gboolean	 pk_package_id_set_remove		(PkPackageIdSet	*set,
+							 const gchar	*package_id);
+void		 pk_package_id_set_union		(PkPackageIdSet	*set,
+							 PkPackageIdSet	*other);
+void		 pk_package_id_set_difference		(PkPackageIdSet	*set,
+							 PkPackageIdSet	*other);
+void		 pk_package_id_set_foreach		(PkPackageIdSet	*set,
+							 GFunc		 func,
+							 gpointer	 user_data);
+gchar		**pk_package_id_set_to_strv		(PkPackageIdSet	*set);
+
+G_END_DECLS
+
+#endif /* __PK_PACKAGE_ID_SET_H */
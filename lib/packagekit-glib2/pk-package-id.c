@@ -26,12 +26,218 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib.h>
 
-#include "src/pk-cleanup.h"
-
 #include <packagekit-glib2/pk-package-id.h>
 
+/* the number of ';' delimited sections in a PackageID */
+#define PK_PACKAGE_ID_SECTIONS		4
+
+/**
+ * pk_package_id_view_init:
+ * @view: a #PkPackageIdView, usually allocated on the stack
+ * @package_id: the ; delimited PackageID
+ *
+ * Initializes a view into @package_id without allocating any memory,
+ * checking the correct number of delimiters are present and that the
+ * name is not empty. The view borrows @package_id, which must not be
+ * modified or freed while the view is in use.
+ *
+ * Return value: %TRUE if the PackageID was well formed
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_view_init (PkPackageIdView *view, const gchar *package_id)
+{
+	guint i;
+	guint section = 0;
+	guint start = 0;
+
+	g_return_val_if_fail (view != NULL, FALSE);
+
+	view->package_id = NULL;
+	if (package_id == NULL)
+		return FALSE;
+
+	/* find each delimeter ';' */
+	for (i = 0; ; i++) {
+		if (package_id[i] != ';' && package_id[i] != '\0')
+			continue;
+
+		/* too many sections */
+		if (section == PK_PACKAGE_ID_SECTIONS)
+			return FALSE;
+		view->offset[section] = start;
+		view->length[section] = i - start;
+		section++;
+		if (package_id[i] == '\0')
+			break;
+		start = i + 1;
+	}
+
+	/* too few sections */
+	if (section != PK_PACKAGE_ID_SECTIONS)
+		return FALSE;
+
+	/* name has to be valid */
+	if (view->length[PK_PACKAGE_ID_NAME] == 0)
+		return FALSE;
+
+	view->package_id = package_id;
+	return TRUE;
+}
+
+/**
+ * pk_package_id_view_get_section:
+ * @view: a valid #PkPackageIdView
+ * @section: the section, e.g. %PK_PACKAGE_ID_NAME
+ * @length: (out) (allow-none): the length of the section in bytes
+ *
+ * Gets a section of the PackageID. The returned string is not nul
+ * terminated at the end of the section, so @length must be used.
+ *
+ * Return value: a pointer into the original PackageID
+ *
+ * Since: 1.0.0
+ **/
+const gchar *
+pk_package_id_view_get_section (const PkPackageIdView *view,
+				guint section,
+				gsize *length)
+{
+	g_return_val_if_fail (view != NULL, NULL);
+	g_return_val_if_fail (view->package_id != NULL, NULL);
+	g_return_val_if_fail (section < PK_PACKAGE_ID_SECTIONS, NULL);
+
+	if (length != NULL)
+		*length = view->length[section];
+	return view->package_id + view->offset[section];
+}
+
+/**
+ * pk_package_id_view_dup_section:
+ * @view: a valid #PkPackageIdView
+ * @section: the section, e.g. %PK_PACKAGE_ID_VERSION
+ *
+ * Copies a section of the PackageID into a new string.
+ *
+ * Return value: the section, use g_free() to free.
+ *
+ * Since: 1.0.0
+ **/
+gchar *
+pk_package_id_view_dup_section (const PkPackageIdView *view, guint section)
+{
+	g_return_val_if_fail (view != NULL, NULL);
+	g_return_val_if_fail (view->package_id != NULL, NULL);
+	g_return_val_if_fail (section < PK_PACKAGE_ID_SECTIONS, NULL);
+
+	return g_strndup (view->package_id + view->offset[section],
+			  view->length[section]);
+}
+
+/**
+ * pk_package_id_view_section_equal:
+ * @view: a valid #PkPackageIdView
+ * @section: the section, e.g. %PK_PACKAGE_ID_NAME
+ * @value: the string to compare against
+ *
+ * Compares a section of the PackageID with a nul terminated string.
+ *
+ * Return value: %TRUE if the section is exactly @value
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_view_section_equal (const PkPackageIdView *view,
+				  guint section,
+				  const gchar *value)
+{
+	guint len;
+
+	g_return_val_if_fail (view != NULL, FALSE);
+	g_return_val_if_fail (view->package_id != NULL, FALSE);
+	g_return_val_if_fail (section < PK_PACKAGE_ID_SECTIONS, FALSE);
+
+	if (value == NULL)
+		return FALSE;
+	len = view->length[section];
+	if (strncmp (view->package_id + view->offset[section], value, len) != 0)
+		return FALSE;
+	return value[len] == '\0';
+}
+
+/**
+ * pk_package_id_view_section_compare:
+ * @view1: a valid #PkPackageIdView
+ * @view2: a valid #PkPackageIdView
+ * @section: the section, e.g. %PK_PACKAGE_ID_NAME
+ *
+ * Compares the same section of two PackageIDs, in the same way as strcmp().
+ *
+ * Return value: negative, zero or positive, suitable for sorting
+ *
+ * Since: 1.0.0
+ **/
+gint
+pk_package_id_view_section_compare (const PkPackageIdView *view1,
+				    const PkPackageIdView *view2,
+				    guint section)
+{
+	gint rc;
+	guint len1;
+	guint len2;
+
+	g_return_val_if_fail (view1 != NULL, 0);
+	g_return_val_if_fail (view2 != NULL, 0);
+	g_return_val_if_fail (section < PK_PACKAGE_ID_SECTIONS, 0);
+
+	len1 = view1->length[section];
+	len2 = view2->length[section];
+	rc = memcmp (view1->package_id + view1->offset[section],
+		     view2->package_id + view2->offset[section],
+		     MIN (len1, len2));
+	if (rc != 0)
+		return rc;
+	if (len1 == len2)
+		return 0;
+	return len1 < len2 ? -1 : 1;
+}
+
+/**
+ * pk_package_id_view_name_equal:
+ * @view1: a valid #PkPackageIdView
+ * @view2: a valid #PkPackageIdView
+ *
+ * Return value: %TRUE if both PackageIDs have the same name
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_view_name_equal (const PkPackageIdView *view1,
+			       const PkPackageIdView *view2)
+{
+	return pk_package_id_view_section_compare (view1, view2, PK_PACKAGE_ID_NAME) == 0;
+}
+
+/**
+ * pk_package_id_view_arch_equal:
+ * @view1: a valid #PkPackageIdView
+ * @view2: a valid #PkPackageIdView
+ *
+ * Return value: %TRUE if both PackageIDs have exactly the same architecture
+ *
+ * Since: 1.0.0
+ **/
+gboolean
+pk_package_id_view_arch_equal (const PkPackageIdView *view1,
+			       const PkPackageIdView *view2)
+{
+	return pk_package_id_view_section_compare (view1, view2, PK_PACKAGE_ID_ARCH) == 0;
+}
+
 /**
  * pk_package_id_split:
  * @package_id: the ; delimited PackageID to split
@@ -46,22 +252,17 @@
 gchar **
 pk_package_id_split (const gchar *package_id)
 {
-	gchar **sections = NULL;
-
-	if (package_id == NULL)
-		goto out;
+	gchar **sections;
+	guint i;
+	PkPackageIdView view;
 
-	/* split by delimeter ';' */
-	sections = g_strsplit (package_id, ";", -1);
-	if (g_strv_length (sections) != 4)
-		goto out;
+	if (!pk_package_id_view_init (&view, package_id))
+		return NULL;
 
-	/* name has to be valid */
-	if (sections[0][0] != '\0')
-		return sections;
-out:
-	g_strfreev (sections);
-	return NULL;
+	sections = g_new0 (gchar *, PK_PACKAGE_ID_SECTIONS + 1);
+	for (i = 0; i < PK_PACKAGE_ID_SECTIONS; i++)
+		sections[i] = pk_package_id_view_dup_section (&view, i);
+	return sections;
 }
 
 /**
@@ -75,23 +276,18 @@ out:
 gboolean
 pk_package_id_check (const gchar *package_id)
 {
-	_cleanup_strv_free_ gchar **sections = NULL;
-	gboolean ret;
+	PkPackageIdView view;
 
 	/* NULL check */
 	if (package_id == NULL)
 		return FALSE;
 
 	/* UTF8 */
-	ret = g_utf8_validate (package_id, -1, NULL);
-	if (!ret)
+	if (!g_utf8_validate (package_id, -1, NULL))
 		return FALSE;
 
 	/* correct number of sections */
-	sections = pk_package_id_split (package_id);
-	if (sections == NULL)
-		return FALSE;
-	return TRUE;
+	return pk_package_id_view_init (&view, package_id);
 }
 
 /**
@@ -122,27 +318,42 @@ pk_package_id_build (const gchar *name, const gchar *version,
  * pk_arch_base_ix86:
  **/
 static gboolean
-pk_arch_base_ix86 (const gchar *arch)
+pk_arch_base_ix86 (const gchar *arch, guint len)
 {
-	if (g_strcmp0 (arch, "i386") == 0 ||
-	    g_strcmp0 (arch, "i486") == 0 ||
-	    g_strcmp0 (arch, "i586") == 0 ||
-	    g_strcmp0 (arch, "i686") == 0)
-		return TRUE;
-	return FALSE;
+	/* i386, i486, i586 or i686 */
+	if (len != 4)
+		return FALSE;
+	if (arch[0] != 'i' || arch[2] != '8' || arch[3] != '6')
+		return FALSE;
+	return arch[1] >= '3' && arch[1] <= '6';
 }
 
 /**
- * pk_package_id_equal_fuzzy_arch_section:
+ * pk_package_id_view_equal_fuzzy_arch:
+ * @view1: a valid #PkPackageIdView
+ * @view2: a valid #PkPackageIdView
+ *
+ * Only compare the name, version, and arch, where the architecture will fuzzy
+ * match with i*86.
+ *
+ * Return value: %TRUE if the PackageIDs can be considered equal.
+ *
+ * Since: 1.0.0
  **/
-static gboolean
-pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
+gboolean
+pk_package_id_view_equal_fuzzy_arch (const PkPackageIdView *view1,
+				     const PkPackageIdView *view2)
 {
-	if (g_strcmp0 (arch1, arch2) == 0)
-		return TRUE;
-	if (pk_arch_base_ix86 (arch1) && pk_arch_base_ix86 (arch2))
+	if (!pk_package_id_view_name_equal (view1, view2))
+		return FALSE;
+	if (pk_package_id_view_section_compare (view1, view2, PK_PACKAGE_ID_VERSION) != 0)
+		return FALSE;
+	if (pk_package_id_view_arch_equal (view1, view2))
 		return TRUE;
-	return FALSE;
+	return pk_arch_base_ix86 (view1->package_id + view1->offset[PK_PACKAGE_ID_ARCH],
+				  view1->length[PK_PACKAGE_ID_ARCH]) &&
+	       pk_arch_base_ix86 (view2->package_id + view2->offset[PK_PACKAGE_ID_ARCH],
+				  view2->length[PK_PACKAGE_ID_ARCH]);
 }
 
 /**
@@ -160,16 +371,14 @@ pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
 gboolean
 pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_id2)
 {
-	_cleanup_strv_free_ gchar **sections1 = NULL;
-	_cleanup_strv_free_ gchar **sections2 = NULL;
-
-	sections1 = pk_package_id_split (package_id1);
-	sections2 = pk_package_id_split (package_id2);
-	if (g_strcmp0 (sections1[0], sections2[0]) == 0 &&
-	    g_strcmp0 (sections1[1], sections2[1]) == 0 &&
-	    pk_package_id_equal_fuzzy_arch_section (sections1[2], sections2[2]))
-		return TRUE;
-	return FALSE;
+	PkPackageIdView view1;
+	PkPackageIdView view2;
+
+	if (!pk_package_id_view_init (&view1, package_id1))
+		return FALSE;
+	if (!pk_package_id_view_init (&view2, package_id2))
+		return FALSE;
+	return pk_package_id_view_equal_fuzzy_arch (&view1, &view2);
 }
 
 /**
@@ -185,31 +394,31 @@ pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_i
 gchar *
 pk_package_id_to_printable (const gchar *package_id)
 {
-	_cleanup_strv_free_  gchar **parts = NULL;
-	gchar *value = NULL;
-	GString *string = NULL;
+	GString *string;
+	PkPackageIdView view;
+	const gchar *tmp;
+	gsize len;
 
 	/* invalid */
-	if (package_id == NULL)
-		goto out;
-
-	/* split */
-	parts = pk_package_id_split (package_id);
-	if (parts == NULL)
-		goto out;
+	if (!pk_package_id_view_init (&view, package_id))
+		return NULL;
 
 	/* name */
-	string = g_string_new (parts[PK_PACKAGE_ID_NAME]);
+	tmp = pk_package_id_view_get_section (&view, PK_PACKAGE_ID_NAME, &len);
+	string = g_string_new_len (tmp, len);
 
 	/* version if present */
-	if (parts[PK_PACKAGE_ID_VERSION][0] != '\0')
-		g_string_append_printf (string, "-%s", parts[PK_PACKAGE_ID_VERSION]);
+	tmp = pk_package_id_view_get_section (&view, PK_PACKAGE_ID_VERSION, &len);
+	if (len > 0) {
+		g_string_append_c (string, '-');
+		g_string_append_len (string, tmp, len);
+	}
 
 	/* arch if present */
-	if (parts[PK_PACKAGE_ID_ARCH][0] != '\0')
-		g_string_append_printf (string, ".%s", parts[PK_PACKAGE_ID_ARCH]);
-out:
-	if (string != NULL)
-		value = g_string_free (string, FALSE);
-	return value;
+	tmp = pk_package_id_view_get_section (&view, PK_PACKAGE_ID_ARCH, &len);
+	if (len > 0) {
+		g_string_append_c (string, '.');
+		g_string_append_len (string, tmp, len);
+	}
+	return g_string_free (string, FALSE);
 }
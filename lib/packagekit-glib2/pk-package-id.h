@@ -58,6 +58,21 @@ G_BEGIN_DECLS
  */
 #define PK_PACKAGE_ID_DATA	3
 
+/**
+ * PkPackageIdView:
+ *
+ * A non-allocating view into a PackageID string, holding the offset and
+ * length of each section. It is only valid for as long as the string it
+ * was initialized with, and should be created on the stack with
+ * pk_package_id_view_init().
+ */
+typedef struct {
+	/*< private >*/
+	const gchar		*package_id;
+	guint			 offset[4];
+	guint			 length[4];
+} PkPackageIdView;
+
 void		 pk_package_id_test			(gpointer		 user_data);
 gchar		*pk_package_id_build			(const gchar		*name,
 							 const gchar		*version,
@@ -68,6 +83,26 @@ gchar		**pk_package_id_split			(const gchar		*package_id);
 gchar		*pk_package_id_to_printable		(const gchar		*package_id);
 gboolean	 pk_package_id_equal_fuzzy_arch		(const gchar		*package_id1,
 							 const gchar		*package_id2);
+
+gboolean	 pk_package_id_view_init		(PkPackageIdView	*view,
+							 const gchar		*package_id);
+const gchar	*pk_package_id_view_get_section		(const PkPackageIdView	*view,
+							 guint			 section,
+							 gsize			*length);
+gchar		*pk_package_id_view_dup_section		(const PkPackageIdView	*view,
+							 guint			 section);
+gboolean	 pk_package_id_view_section_equal	(const PkPackageIdView	*view,
+							 guint			 section,
+							 const gchar		*value);
+gint		 pk_package_id_view_section_compare	(const PkPackageIdView	*view1,
+							 const PkPackageIdView	*view2,
+							 guint			 section);
+gboolean	 pk_package_id_view_name_equal		(const PkPackageIdView	*view1,
+							 const PkPackageIdView	*view2);
+gboolean	 pk_package_id_view_arch_equal		(const PkPackageIdView	*view1,
+							 const PkPackageIdView	*view2);
+gboolean	 pk_package_id_view_equal_fuzzy_arch	(const PkPackageIdView	*view1,
+							 const PkPackageIdView	*view2);
 G_END_DECLS
 
 #endif /* __PK_PACKAGE_ID_H */
@@ -24,6 +24,9 @@
  * @short_description: Functionality to modify multiple PackageIDs
  *
  * Composite PackageId's are difficult to read and create.
+ *
+ * These functions scan and copy the whole array each time they are called,
+ * so #PkPackageIdSet should be used when building up large lists.
  */
 
 #include "config.h"
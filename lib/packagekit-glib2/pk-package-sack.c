@@ -538,22 +538,21 @@ PkPackage *
 pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_id)
 {
 	PkPackage *pkg_tmp;
+	PkPackageIdView view;
 	guint i;
-	_cleanup_strv_free_ gchar **split = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	/* does the package name feature in the array */
-	split = pk_package_id_split (package_id);
-	if (split == NULL)
+	if (!pk_package_id_view_init (&view, package_id))
 		return NULL;
 	for (i = 0; i < sack->priv->array->len; i++) {
 		pkg_tmp = g_ptr_array_index (sack->priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
-			       split[PK_PACKAGE_ID_ARCH]) == 0) {
+		if (pk_package_id_view_section_equal (&view, PK_PACKAGE_ID_NAME,
+						      pk_package_get_name (pkg_tmp)) &&
+		    pk_package_id_view_section_equal (&view, PK_PACKAGE_ID_ARCH,
+						      pk_package_get_arch (pkg_tmp))) {
 			return g_object_ref (pkg_tmp);
 		}
 	}
@@ -566,16 +565,13 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 static gint
 pk_package_sack_sort_compare_name_func (PkPackage **a, PkPackage **b)
 {
-	const gchar *package_id1;
-	const gchar *package_id2;
-	_cleanup_strv_free_ gchar **split1 = NULL;
-	_cleanup_strv_free_ gchar **split2 = NULL;
+	PkPackageIdView view1;
+	PkPackageIdView view2;
 
-	package_id1 = pk_package_get_id (*a);
-	package_id2 = pk_package_get_id (*b);
-	split1 = pk_package_id_split (package_id1);
-	split2 = pk_package_id_split (package_id2);
-	return g_strcmp0 (split1[PK_PACKAGE_ID_NAME], split2[PK_PACKAGE_ID_NAME]);
+	if (!pk_package_id_view_init (&view1, pk_package_get_id (*a)) ||
+	    !pk_package_id_view_init (&view2, pk_package_get_id (*b)))
+		return g_strcmp0 (pk_package_get_id (*a), pk_package_get_id (*b));
+	return pk_package_id_view_section_compare (&view1, &view2, PK_PACKAGE_ID_NAME);
 }
 
 /**
@@ -30,7 +30,9 @@
 
 #include "pk-client.h"
 #include "pk-client-helper.h"
+#include "pk-client-private.h"
 #include "pk-control.h"
+#include "pk-control-private.h"
 #include "pk-console-shared.h"
 #include "pk-offline.h"
 #include "pk-offline-private.h"
@@ -630,6 +632,7 @@ pk_test_client_func (void)
 	g_object_unref (progress);
 	g_free (tid);
 	g_free (_tid);
+	_tid = NULL;
 
 	/* got updates */
 	g_assert_cmpint (_progress_cb, >, 0);
@@ -725,6 +728,129 @@ pk_test_client_func (void)
 #endif
 }
 
+static void
+pk_test_client_create_and_run_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	gchar *tid;
+
+	tid = pk_control_create_transaction_and_run_finish (PK_CONTROL (object), res, &error);
+	g_assert_no_error (error);
+	g_assert (tid != NULL);
+	g_assert (g_variant_is_object_path (tid));
+	g_assert (g_str_has_prefix (tid, "/"));
+	g_free (tid);
+	_g_test_loop_quit ();
+}
+
+static PkStatusEnum _first_status = PK_STATUS_ENUM_UNKNOWN;
+
+static void
+pk_test_client_first_status_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	if (type == PK_PROGRESS_TYPE_STATUS && _first_status == PK_STATUS_ENUM_UNKNOWN)
+		g_object_get (progress, "status", &_first_status, NULL);
+	pk_test_client_progress_cb (progress, type, user_data);
+}
+
+static void
+pk_test_client_create_and_run_func (void)
+{
+	gchar **package_ids;
+	const gchar *hints[] = { "locale=en_GB.utf8", NULL };
+	_cleanup_object_unref_ PkClient *client = NULL;
+	_cleanup_object_unref_ PkControl *control = NULL;
+	_cleanup_error_free_ GError *error = NULL;
+
+	/* the daemon replies with the object path of the started transaction */
+	control = pk_control_new ();
+	pk_control_get_properties (control, NULL, &error);
+	g_assert_no_error (error);
+	package_ids = pk_package_ids_from_string ("glib2;2.14.0;i386;fedora&powertop");
+	pk_control_create_transaction_and_run_async (control,
+						     (gchar **) hints,
+						     "Resolve",
+						     g_variant_new ("(t^as)",
+								    pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+								    package_ids),
+						     NULL,
+						     (GAsyncReadyCallback) pk_test_client_create_and_run_cb, NULL);
+	_g_test_loop_run_with_timeout (15000);
+
+	/* the WAIT status is emitted before the reply, so the client only
+	 * sees it if it replays the signals it got before it had the tid */
+	g_free (_tid);
+	_tid = NULL;
+	_first_status = PK_STATUS_ENUM_UNKNOWN;
+	client = pk_client_new ();
+	pk_client_resolve_async (client, pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids, NULL,
+		 (PkProgressCallback) pk_test_client_first_status_cb, NULL,
+		 (GAsyncReadyCallback) pk_test_client_resolve_cb, NULL);
+	g_strfreev (package_ids);
+	_g_test_loop_run_with_timeout (15000);
+	g_assert (!pk_client_get_legacy_daemon (client));
+	g_assert_cmpint (_first_status, ==, PK_STATUS_ENUM_WAIT);
+	g_assert (_tid != NULL);
+	g_free (_tid);
+	_tid = NULL;
+}
+
+static void
+pk_test_client_legacy_create_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+	gchar *tid;
+
+	tid = pk_control_create_transaction_and_run_finish (PK_CONTROL (object), res, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+	g_assert (tid == NULL);
+	g_error_free (error);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_client_legacy_func (void)
+{
+	gchar **package_ids;
+	const gchar *hints[] = { NULL };
+	_cleanup_object_unref_ PkClient *client = NULL;
+	_cleanup_object_unref_ PkControl *control = NULL;
+	_cleanup_error_free_ GError *error = NULL;
+
+	/* pretend the daemon cannot create and run in one call */
+	control = pk_control_new ();
+	pk_control_get_properties (control, NULL, &error);
+	g_assert_no_error (error);
+	pk_control_set_can_create_transaction_and_run (control, FALSE);
+	package_ids = pk_package_ids_from_string ("glib2;2.14.0;i386;fedora&powertop");
+	pk_control_create_transaction_and_run_async (control,
+						     (gchar **) hints,
+						     "Resolve",
+						     g_variant_new ("(t^as)",
+								    pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+								    package_ids),
+						     NULL,
+						     (GAsyncReadyCallback) pk_test_client_legacy_create_cb, NULL);
+	_g_test_loop_run_with_timeout (15000);
+
+	/* so the client falls back to CreateTransaction and SetHints */
+	g_free (_tid);
+	_tid = NULL;
+	client = pk_client_new ();
+	g_assert (!pk_client_get_legacy_daemon (client));
+	pk_client_resolve_async (client, pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids, NULL,
+		 (PkProgressCallback) pk_test_client_progress_cb, NULL,
+		 (GAsyncReadyCallback) pk_test_client_resolve_cb, NULL);
+	g_strfreev (package_ids);
+	_g_test_loop_run_with_timeout (15000);
+	g_assert (pk_client_get_legacy_daemon (client));
+	g_assert (_tid != NULL);
+	g_free (_tid);
+	_tid = NULL;
+
+	pk_control_set_can_create_transaction_and_run (control, TRUE);
+}
+
 static void
 pk_test_console_func (void)
 {
@@ -1442,6 +1568,8 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/transaction-list", pk_test_transaction_list_func);
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 	g_test_add_func ("/packagekit-glib2/client", pk_test_client_func);
+	g_test_add_func ("/packagekit-glib2/client-create-and-run", pk_test_client_create_and_run_func);
+	g_test_add_func ("/packagekit-glib2/client-legacy", pk_test_client_legacy_func);
 	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
 	g_test_add_func ("/packagekit-glib2/task", pk_test_task_func);
 	g_test_add_func ("/packagekit-glib2/task-wrapper", pk_test_task_wrapper_func);
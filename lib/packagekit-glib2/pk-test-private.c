@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib-object.h>
 
 #include "src/pk-cleanup.h"
@@ -32,6 +33,7 @@
 #include "pk-offline-private.h"
 #include "pk-package.h"
 #include "pk-package-id.h"
+#include "pk-package-id-set.h"
 #include "pk-package-ids.h"
 #include "pk-progress-bar.h"
 #include "pk-results.h"
@@ -216,6 +218,28 @@ pk_test_enum_func (void)
 	string = pk_role_enum_to_string (PK_ROLE_ENUM_SEARCH_FILE);
 	g_assert_cmpstr (string, ==, "search-file");
 
+	/* unknown values fall back to the first entry */
+	role_value = pk_role_enum_from_string ("search-filez");
+	g_assert_cmpint (role_value, ==, PK_ROLE_ENUM_UNKNOWN);
+	role_value = pk_role_enum_from_string ("");
+	g_assert_cmpint (role_value, ==, PK_ROLE_ENUM_UNKNOWN);
+	role_value = pk_role_enum_from_string (NULL);
+	g_assert_cmpint (role_value, ==, PK_ROLE_ENUM_UNKNOWN);
+
+	/* check the generated lookup agrees with the tables */
+	for (i = 1; i < PK_ROLE_ENUM_LAST; i++) {
+		string = pk_role_enum_to_string (i);
+		g_assert_cmpint (pk_role_enum_from_string (string), ==, i);
+	}
+	for (i = 1; i < PK_INFO_ENUM_LAST; i++) {
+		string = pk_info_enum_to_string (i);
+		g_assert_cmpint (pk_info_enum_from_string (string), ==, i);
+	}
+	for (i = 1; i < PK_GROUP_ENUM_LAST; i++) {
+		string = pk_group_enum_to_string (i);
+		g_assert_cmpint (pk_group_enum_from_string (string), ==, i);
+	}
+
 	/* check we convert all the role bitfield */
 	for (i = 1; i < PK_ROLE_ENUM_LAST; i++) {
 		string = pk_role_enum_to_string (i);
@@ -404,6 +428,100 @@ pk_test_package_id_func (void)
 	/* test fail missing first */
 	sections = pk_package_id_split (";0.1.2;i386;data");
 	g_assert (sections == NULL);
+
+	/* test fuzzy arch */
+	g_assert (pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora",
+						  "moo;0.0.1;i686;updates"));
+	g_assert (pk_package_id_equal_fuzzy_arch ("moo;0.0.1;noarch;fedora",
+						  "moo;0.0.1;noarch;updates"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora",
+						   "moo;0.0.1;x86_64;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora",
+						   "moo;0.0.2;i386;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora",
+						   "mooo;0.0.1;i386;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.0.1;i386;fedora", "moo"));
+}
+
+static void
+pk_test_package_id_view_func (void)
+{
+	const gchar *tmp;
+	gboolean ret;
+	gchar *text;
+	gsize len;
+	PkPackageIdView view1;
+	PkPackageIdView view2;
+
+	/* check not valid */
+	ret = pk_package_id_view_init (&view1, NULL);
+	g_assert (!ret);
+	ret = pk_package_id_view_init (&view1, ";0.0.1;i386;fedora");
+	g_assert (!ret);
+	ret = pk_package_id_view_init (&view1, "moo;0.0.1;i386");
+	g_assert (!ret);
+	ret = pk_package_id_view_init (&view1, "moo;0.0.1;i386;fedora;");
+	g_assert (!ret);
+
+	/* check valid */
+	ret = pk_package_id_view_init (&view1, "moo;0.0.1;i386;fedora");
+	g_assert (ret);
+	tmp = pk_package_id_view_get_section (&view1, PK_PACKAGE_ID_VERSION, &len);
+	g_assert_cmpint (len, ==, 5);
+	g_assert (strncmp (tmp, "0.0.1", len) == 0);
+	text = pk_package_id_view_dup_section (&view1, PK_PACKAGE_ID_DATA);
+	g_assert_cmpstr (text, ==, "fedora");
+	g_free (text);
+
+	/* compare sections with strings */
+	g_assert (pk_package_id_view_section_equal (&view1, PK_PACKAGE_ID_NAME, "moo"));
+	g_assert (!pk_package_id_view_section_equal (&view1, PK_PACKAGE_ID_NAME, "mo"));
+	g_assert (!pk_package_id_view_section_equal (&view1, PK_PACKAGE_ID_NAME, "mooo"));
+	g_assert (!pk_package_id_view_section_equal (&view1, PK_PACKAGE_ID_NAME, NULL));
+
+	/* compare two views */
+	ret = pk_package_id_view_init (&view2, "moo-libs;0.0.1;i686;;");
+	g_assert (!ret);
+	ret = pk_package_id_view_init (&view2, "moo-libs;0.0.1;i686;");
+	g_assert (ret);
+	g_assert (!pk_package_id_view_name_equal (&view1, &view2));
+	g_assert (!pk_package_id_view_arch_equal (&view1, &view2));
+	g_assert_cmpint (pk_package_id_view_section_compare (&view1, &view2, PK_PACKAGE_ID_NAME), <, 0);
+	g_assert_cmpint (pk_package_id_view_section_compare (&view2, &view1, PK_PACKAGE_ID_NAME), >, 0);
+	g_assert_cmpint (pk_package_id_view_section_compare (&view1, &view2, PK_PACKAGE_ID_VERSION), ==, 0);
+	ret = pk_package_id_view_init (&view2, "moo;0.0.1;i686;");
+	g_assert (ret);
+	g_assert (pk_package_id_view_name_equal (&view1, &view2));
+	g_assert (pk_package_id_view_equal_fuzzy_arch (&view1, &view2));
+}
+
+static void
+pk_test_package_id_view_perf_func (void)
+{
+	const gchar *package_id = "kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;installed";
+	gdouble elapsed;
+	guint i;
+	guint loops = 100000;
+	PkPackageIdView view;
+
+	/* allocating split */
+	g_test_timer_start ();
+	for (i = 0; i < loops; i++) {
+		_cleanup_strv_free_ gchar **split = NULL;
+		split = pk_package_id_split (package_id);
+		g_assert (g_strcmp0 (split[PK_PACKAGE_ID_NAME], "kde-i18n-csb") == 0);
+	}
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "split: %u lookups in %.3fs", loops, elapsed);
+
+	/* non-allocating view */
+	g_test_timer_start ();
+	for (i = 0; i < loops; i++) {
+		g_assert (pk_package_id_view_init (&view, package_id));
+		g_assert (pk_package_id_view_section_equal (&view, PK_PACKAGE_ID_NAME, "kde-i18n-csb"));
+	}
+	elapsed = g_test_timer_elapsed ();
+	g_test_minimized_result (elapsed, "view: %u lookups in %.3fs", loops, elapsed);
 }
 
 static void
@@ -431,6 +549,57 @@ pk_test_package_ids_func (void)
 	g_strfreev (package_ids);
 }
 
+static void
+pk_test_package_id_set_func (void)
+{
+	gboolean ret;
+	gchar **package_ids;
+	gchar *package_ids_dupe[] = { "foo;0.0.1;i386;fedora",
+				      "bar;0.1.1;noarch;livna",
+				      "foo;0.0.1;i386;fedora",
+				      NULL };
+	gchar *package_ids_other[] = { "baz;1.0;x86_64;fedora",
+				       "bar;0.1.1;noarch;livna",
+				       NULL };
+	PkPackageIdSet *set;
+	PkPackageIdSet *other;
+
+	/* duplicates are ignored */
+	set = pk_package_id_set_new_from_strv (package_ids_dupe);
+	g_assert_cmpint (pk_package_id_set_get_size (set), ==, 2);
+	g_assert (pk_package_id_set_contains (set, "foo;0.0.1;i386;fedora"));
+	g_assert (!pk_package_id_set_contains (set, "foo;0.0.2;i386;fedora"));
+	ret = pk_package_id_set_add (set, "bar;0.1.1;noarch;livna");
+	g_assert (!ret);
+
+	/* union keeps insertion order */
+	other = pk_package_id_set_new_from_strv (package_ids_other);
+	pk_package_id_set_union (set, other);
+	package_ids = pk_package_id_set_to_strv (set);
+	g_assert_cmpint (g_strv_length (package_ids), ==, 3);
+	g_assert_cmpstr (package_ids[0], ==, "foo;0.0.1;i386;fedora");
+	g_assert_cmpstr (package_ids[1], ==, "bar;0.1.1;noarch;livna");
+	g_assert_cmpstr (package_ids[2], ==, "baz;1.0;x86_64;fedora");
+	g_strfreev (package_ids);
+
+	/* difference */
+	pk_package_id_set_difference (set, other);
+	package_ids = pk_package_id_set_to_strv (set);
+	g_assert_cmpint (g_strv_length (package_ids), ==, 1);
+	g_assert_cmpstr (package_ids[0], ==, "foo;0.0.1;i386;fedora");
+	g_strfreev (package_ids);
+
+	/* remove */
+	ret = pk_package_id_set_remove (set, "foo;0.0.1;i386;fedora");
+	g_assert (ret);
+	ret = pk_package_id_set_remove (set, "foo;0.0.1;i386;fedora");
+	g_assert (!ret);
+	g_assert_cmpint (pk_package_id_set_get_size (set), ==, 0);
+
+	pk_package_id_set_unref (other);
+	pk_package_id_set_unref (set);
+}
+
 static void
 pk_test_progress_func (void)
 {
@@ -825,13 +994,19 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/enum", pk_test_enum_func);
 	g_test_add_func ("/packagekit-glib2/bitfield", pk_test_bitfield_func);
 	g_test_add_func ("/packagekit-glib2/package-id", pk_test_package_id_func);
+	g_test_add_func ("/packagekit-glib2/package-id-view", pk_test_package_id_view_func);
 	g_test_add_func ("/packagekit-glib2/package-ids", pk_test_package_ids_func);
+	g_test_add_func ("/packagekit-glib2/package-id-set", pk_test_package_id_set_func);
 	g_test_add_func ("/packagekit-glib2/progress", pk_test_progress_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 
+	/* only run with -m perf */
+	if (g_test_perf ())
+		g_test_add_func ("/packagekit-glib2/package-id-view-perf", pk_test_package_id_view_perf_func);
+
 	return g_test_run ();
 }
 
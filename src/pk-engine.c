@@ -1039,6 +1039,8 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 		return g_variant_new_uint32 (engine->priv->network_state);
 	if (g_strcmp0 (property_name, "DistroId") == 0)
 		return _g_variant_new_maybe_string (engine->priv->distro_id);
+	if (g_strcmp0 (property_name, "CanCreateTransactionAndRun") == 0)
+		return g_variant_new_boolean (TRUE);
 
 	/* return an error */
 	g_set_error (error,
@@ -1242,13 +1244,16 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	PkAuthorizeEnum result_enum;
 	PkEngine *engine = PK_ENGINE (user_data);
 	PkRoleEnum role;
+	PkTransaction *transaction;
 	gchar **transaction_list;
 	gchar **package_names;
 	guint size;
 	gboolean is_priority = TRUE;
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_free_ gchar *data = NULL;
+	_cleanup_free_ const gchar **hints = NULL;
 	_cleanup_strv_free_ gchar **array = NULL;
+	_cleanup_variant_unref_ GVariant *params = NULL;
 
 	g_return_if_fail (PK_IS_ENGINE (engine));
 
@@ -1318,6 +1323,30 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "CreateTransactionAndRun") == 0) {
+
+		g_variant_get (parameters, "(^a&s&sv)", &hints, &tmp, &params);
+		g_debug ("CreateTransactionAndRun method called for %s", tmp);
+		data = pk_transaction_db_generate_id (engine->priv->transaction_db);
+		g_assert (data != NULL);
+		ret = pk_scheduler_create (engine->priv->scheduler,
+					   data, sender, &error);
+		if (!ret) {
+			g_dbus_method_invocation_return_error (invocation,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+							       "could not create transaction %s: %s",
+							       data,
+							       error->message);
+			return;
+		}
+
+		/* the transaction replies with the object path when done */
+		transaction = pk_scheduler_get_transaction (engine->priv->scheduler, data);
+		pk_transaction_run_method (transaction, hints, tmp, params, invocation);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetTransactionList") == 0) {
 		transaction_list = pk_scheduler_get_array (engine->priv->scheduler);
 		value = g_variant_new ("(^a&o)", transaction_list);
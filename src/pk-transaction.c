@@ -44,6 +44,7 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-offline-private.h>
 #include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-package-id-set.h>
 #include <packagekit-glib2/pk-package-ids.h>
 #include <packagekit-glib2/pk-results.h>
 #include <polkit/polkit.h>
@@ -125,6 +126,7 @@ struct PkTransactionPrivate
 	PkBitfield		 cached_transaction_flags;
 	gchar			*cached_package_id;
 	gchar			**cached_package_ids;
+	PkPackageIdSet		*cached_package_id_set;
 	gchar			*cached_transaction_id;
 	gchar			**cached_full_paths;
 	PkBitfield		 cached_filters;
@@ -993,6 +995,11 @@ pk_transaction_offline_invalidate_check (PkTransaction *transaction)
 	invalidated = pk_results_get_package_array (transaction->priv->results);
 	for (i = 0; i < invalidated->len; i++) {
 		package_id = pk_package_get_id (g_ptr_array_index (invalidated, i));
+
+		/* already checked above */
+		if (pk_package_id_set_contains (transaction->priv->cached_package_id_set,
+						package_id))
+			continue;
 		pkg = pk_package_sack_find_by_id_name_arch (sack, package_id);
 		if (pkg != NULL) {
 			g_debug ("%s modified %s, invalidating prepared-updates",
@@ -2610,22 +2617,50 @@ pk_transaction_set_role (PkTransaction *transaction, PkRoleEnum role)
 					      g_variant_new_uint32 (role));
 }
 
+/**
+ * pk_transaction_set_cached_package_ids:
+ **/
+static void
+pk_transaction_set_cached_package_ids (PkTransaction *transaction,
+				       gchar **package_ids)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	/* drop any duplicates, keeping the order the client asked for */
+	if (priv->cached_package_id_set != NULL)
+		pk_package_id_set_unref (priv->cached_package_id_set);
+	priv->cached_package_id_set = pk_package_id_set_new_from_strv (package_ids);
+	g_strfreev (priv->cached_package_ids);
+	priv->cached_package_ids = pk_package_id_set_to_strv (priv->cached_package_id_set);
+}
+
 /**
  * pk_transaction_dbus_return:
  **/
 static void
 pk_transaction_dbus_return (GDBusMethodInvocation *context, const GError *error)
 {
+	const gchar *tid;
+
 	/* not set inside the test suite */
 	if (context == NULL) {
 		if (error != NULL)
 			g_warning ("context null, and error: %s", error->message);
 		return;
 	}
-	if (error != NULL)
+	if (error != NULL) {
 		g_dbus_method_invocation_return_gerror (context, error);
-	else
-		g_dbus_method_invocation_return_value (context, NULL);
+		return;
+	}
+
+	/* called from CreateTransactionAndRun, so return the object path */
+	tid = g_object_get_data (G_OBJECT (context), "PkTransaction::tid");
+	if (tid != NULL) {
+		g_dbus_method_invocation_return_value (context,
+						       g_variant_new ("(o)", tid));
+		return;
+	}
+	g_dbus_method_invocation_return_value (context, NULL);
 }
 
 /**
@@ -2899,7 +2934,7 @@ pk_transaction_download_packages (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	transaction->priv->cached_directory = g_strdup (directory);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DOWNLOAD_PACKAGES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
@@ -3002,7 +3037,7 @@ pk_transaction_depends_on (PkTransaction *transaction,
 
 	/* save so we can run later */
 	transaction->priv->cached_filters = filter;
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	transaction->priv->cached_force = recursive;
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_DEPENDS_ON);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
@@ -3069,7 +3104,7 @@ pk_transaction_get_details (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
@@ -3375,7 +3410,7 @@ pk_transaction_get_files (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_FILES);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
@@ -3598,7 +3633,7 @@ pk_transaction_required_by (PkTransaction *transaction,
 
 	/* save so we can run later */
 	transaction->priv->cached_filters = filter;
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	transaction->priv->cached_force = recursive;
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REQUIRED_BY);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
@@ -3665,7 +3700,7 @@ pk_transaction_get_update_detail (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_UPDATE_DETAIL);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
 out:
@@ -3930,7 +3965,7 @@ pk_transaction_install_packages (PkTransaction *transaction,
 
 	/* save so we can run later */
 	transaction->priv->cached_transaction_flags = transaction_flags;
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_INSTALL_PACKAGES);
 
 	/* this changed */
@@ -4138,7 +4173,7 @@ pk_transaction_remove_packages (PkTransaction *transaction,
 
 	/* save so we can run later */
 	transaction->priv->cached_transaction_flags = transaction_flags;
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	transaction->priv->cached_allow_deps = allow_deps;
 	transaction->priv->cached_autoremove = autoremove;
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REMOVE_PACKAGES);
@@ -4409,7 +4444,7 @@ pk_transaction_resolve (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_package_ids = g_strdupv (packages);
+	pk_transaction_set_cached_package_ids (transaction, packages);
 	transaction->priv->cached_filters = filter;
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_RESOLVE);
 	pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
@@ -4777,6 +4812,34 @@ pk_transaction_set_hint (PkTransaction *transaction,
 	return TRUE;
 }
 
+/**
+ * pk_transaction_set_hints_strv:
+ */
+static gboolean
+pk_transaction_set_hints_strv (PkTransaction *transaction,
+			       const gchar **hints,
+			       GError **error)
+{
+	guint i;
+
+	for (i = 0; hints[i] != NULL; i++) {
+		_cleanup_strv_free_ gchar **sections = NULL;
+		sections = g_strsplit (hints[i], "=", 2);
+		if (g_strv_length (sections) != 2) {
+			g_set_error (error, PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "Could not parse hint '%s'", hints[i]);
+			return FALSE;
+		}
+		if (!pk_transaction_set_hint (transaction,
+					      sections[0],
+					      sections[1],
+					      error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_transaction_set_hints:
  */
@@ -4785,8 +4848,6 @@ pk_transaction_set_hints (PkTransaction *transaction,
 			  GVariant *params,
 			  GDBusMethodInvocation *context)
 {
-	gboolean ret;
-	guint i;
 	const gchar **hints = NULL;
 	_cleanup_error_free_ GError *error = NULL;
 	_cleanup_free_ gchar *dbg = NULL;
@@ -4797,26 +4858,8 @@ pk_transaction_set_hints (PkTransaction *transaction,
 	g_variant_get (params, "(^a&s)", &hints);
 	dbg = g_strjoinv (", ", (gchar**) hints);
 	g_debug ("SetHints method called: %s", dbg);
-
-	/* parse */
-	for (i = 0; hints[i] != NULL; i++) {
-		_cleanup_strv_free_ gchar **sections = NULL;
-		sections = g_strsplit (hints[i], "=", 2);
-		if (g_strv_length (sections) == 2) {
-			ret = pk_transaction_set_hint (transaction,
-						       sections[0],
-						       sections[1],
-						       &error);
-			if (!ret)
-				goto out;
-		} else {
-			g_set_error (&error, PK_TRANSACTION_ERROR,
-					     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
-					     "Could not parse hint '%s'", hints[i]);
-			goto out;
-		}
-	}
-out:
+	pk_transaction_set_hints_strv (transaction, hints, &error);
+	g_free (hints);
 	pk_transaction_dbus_return (context, error);
 }
 
@@ -4885,7 +4928,7 @@ pk_transaction_update_packages (PkTransaction *transaction,
 
 	/* save so we can run later */
 	transaction->priv->cached_transaction_flags = transaction_flags;
-	transaction->priv->cached_package_ids = g_strdupv (package_ids);
+	pk_transaction_set_cached_package_ids (transaction, package_ids);
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_UPDATE_PACKAGES);
 
 	/* this changed */
@@ -5058,160 +5101,178 @@ pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
 }
 
 /**
- * pk_transaction_method_call:
+ * pk_transaction_role_method_call:
+ *
+ * Return value: %FALSE if @method_name is not a role method
  **/
-static void
-pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
-			    const gchar *object_path, const gchar *interface_name,
-			    const gchar *method_name, GVariant *parameters,
-			    GDBusMethodInvocation *invocation, gpointer user_data)
+static gboolean
+pk_transaction_role_method_call (PkTransaction *transaction,
+				 const gchar *method_name,
+				 GVariant *parameters,
+				 GDBusMethodInvocation *invocation)
 {
-	PkTransaction *transaction = PK_TRANSACTION (user_data);
-
-	g_return_if_fail (transaction->priv->sender != NULL);
-
-	/* check is the same as the sender that did CreateTransaction */
-	if (g_strcmp0 (transaction->priv->sender, sender) != 0) {
-		g_dbus_method_invocation_return_error (invocation,
-						       PK_TRANSACTION_ERROR,
-						       PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
-						       "sender does not match (%s vs %s)",
-						       sender,
-						       transaction->priv->sender);
-		return;
-	}
-	if (g_strcmp0 (method_name, "SetHints") == 0) {
-		pk_transaction_set_hints (transaction, parameters, invocation);
-		return;
-	}
 	if (g_strcmp0 (method_name, "AcceptEula") == 0) {
 		pk_transaction_accept_eula (transaction, parameters, invocation);
-		return;
-	}
-	if (g_strcmp0 (method_name, "Cancel") == 0) {
-		pk_transaction_cancel (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "DownloadPackages") == 0) {
 		pk_transaction_download_packages (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetCategories") == 0) {
 		pk_transaction_get_categories (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "DependsOn") == 0) {
 		pk_transaction_depends_on (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDetails") == 0) {
 		pk_transaction_get_details (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDetailsLocal") == 0) {
 		pk_transaction_get_details_local (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetFilesLocal") == 0) {
 		pk_transaction_get_files_local (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetFiles") == 0) {
 		pk_transaction_get_files (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetOldTransactions") == 0) {
 		pk_transaction_get_old_transactions (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetPackages") == 0) {
 		pk_transaction_get_packages (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetRepoList") == 0) {
 		pk_transaction_get_repo_list (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RequiredBy") == 0) {
 		pk_transaction_required_by (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetUpdateDetail") == 0) {
 		pk_transaction_get_update_detail (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetUpdates") == 0) {
 		pk_transaction_get_updates (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "GetDistroUpgrades") == 0) {
 		pk_transaction_get_distro_upgrades (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallFiles") == 0) {
 		pk_transaction_install_files (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallPackages") == 0) {
 		pk_transaction_install_packages (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "InstallSignature") == 0) {
 		pk_transaction_install_signature (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RefreshCache") == 0) {
 		pk_transaction_refresh_cache (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RemovePackages") == 0) {
 		pk_transaction_remove_packages (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoEnable") == 0) {
 		pk_transaction_repo_enable (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoSetData") == 0) {
 		pk_transaction_repo_set_data (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepoRemove") == 0) {
 		pk_transaction_repo_remove (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "Resolve") == 0) {
 		pk_transaction_resolve (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchDetails") == 0) {
 		pk_transaction_search_details (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchFiles") == 0) {
 		pk_transaction_search_files (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchGroups") == 0) {
 		pk_transaction_search_groups (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "SearchNames") == 0) {
 		pk_transaction_search_names (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "UpdatePackages") == 0) {
 		pk_transaction_update_packages (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "WhatProvides") == 0) {
 		pk_transaction_what_provides (transaction, parameters, invocation);
-		return;
+		return TRUE;
 	}
 	if (g_strcmp0 (method_name, "RepairSystem") == 0) {
 		pk_transaction_repair_system (transaction, parameters, invocation);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * pk_transaction_method_call:
+ **/
+static void
+pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
+			    const gchar *object_path, const gchar *interface_name,
+			    const gchar *method_name, GVariant *parameters,
+			    GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+
+	g_return_if_fail (transaction->priv->sender != NULL);
+
+	/* check is the same as the sender that did CreateTransaction */
+	if (g_strcmp0 (transaction->priv->sender, sender) != 0) {
+		g_dbus_method_invocation_return_error (invocation,
+						       PK_TRANSACTION_ERROR,
+						       PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+						       "sender does not match (%s vs %s)",
+						       sender,
+						       transaction->priv->sender);
+		return;
+	}
+	if (g_strcmp0 (method_name, "SetHints") == 0) {
+		pk_transaction_set_hints (transaction, parameters, invocation);
+		return;
+	}
+	if (g_strcmp0 (method_name, "Cancel") == 0) {
+		pk_transaction_cancel (transaction, parameters, invocation);
 		return;
 	}
+	if (pk_transaction_role_method_call (transaction, method_name,
+					     parameters, invocation))
+		return;
 
 	/* nothing matched */
 	g_dbus_method_invocation_return_error (invocation,
@@ -5221,6 +5282,73 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 					       sender);
 }
 
+/**
+ * pk_transaction_run_method:
+ * @transaction: a #PkTransaction
+ * @hints: the hints, as passed to SetHints
+ * @method_name: the role method to call, e.g. "Resolve"
+ * @parameters: the role method parameters
+ * @context: the engine method invocation
+ *
+ * Applies the hints and calls the role method in one step. On success the
+ * transaction ID is returned to @context rather than an empty reply.
+ **/
+void
+pk_transaction_run_method (PkTransaction *transaction,
+			   const gchar **hints,
+			   const gchar *method_name,
+			   GVariant *parameters,
+			   GDBusMethodInvocation *context)
+{
+	GDBusMethodInfo *method_info;
+	guint i;
+	_cleanup_error_free_ GError *error = NULL;
+	_cleanup_string_free_ GString *signature = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->priv->tid != NULL);
+
+	/* the parameters are a variant, so check them against the
+	 * introspection data as GDBus would have done */
+	method_info = g_dbus_interface_info_lookup_method (transaction->priv->introspection->interfaces[0],
+							   method_name);
+	if (method_info == NULL ||
+	    g_strcmp0 (method_name, "SetHints") == 0 ||
+	    g_strcmp0 (method_name, "Cancel") == 0) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "%s is not a role method", method_name);
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	signature = g_string_new ("(");
+	for (i = 0; method_info->in_args != NULL && method_info->in_args[i] != NULL; i++)
+		g_string_append (signature, method_info->in_args[i]->signature);
+	g_string_append (signature, ")");
+	if (g_strcmp0 (g_variant_get_type_string (parameters), signature->str) != 0) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "%s expects %s, not %s", method_name,
+			     signature->str,
+			     g_variant_get_type_string (parameters));
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+
+	/* apply the hints before the role method looks at them */
+	if (!pk_transaction_set_hints_strv (transaction, hints, &error)) {
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+
+	g_object_set_data_full (G_OBJECT (context), "PkTransaction::tid",
+				g_strdup (transaction->priv->tid), g_free);
+	pk_transaction_role_method_call (transaction, method_name,
+					 parameters, context);
+}
+
 /**
  * pk_transaction_set_tid:
  */
@@ -5397,6 +5525,8 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->cached_package_id);
 	g_free (transaction->priv->cached_key_id);
 	g_strfreev (transaction->priv->cached_package_ids);
+	if (transaction->priv->cached_package_id_set != NULL)
+		pk_package_id_set_unref (transaction->priv->cached_package_id_set);
 	g_free (transaction->priv->cached_transaction_id);
 	g_free (transaction->priv->cached_directory);
 	g_strfreev (transaction->priv->cached_values);
@@ -67,6 +67,11 @@ PkTransaction	*pk_transaction_new				(GKeyFile		*conf,
 /* go go go! */
 gboolean	 pk_transaction_run				(PkTransaction	*transaction)
 								 G_GNUC_WARN_UNUSED_RESULT;
+void		 pk_transaction_run_method			(PkTransaction	*transaction,
+								 const gchar	**hints,
+								 const gchar	*method_name,
+								 GVariant	*parameters,
+								 GDBusMethodInvocation *context);
 /* internal status */
 void		 pk_transaction_cancel_bg			(PkTransaction	*transaction);
 gboolean	 pk_transaction_get_background			(PkTransaction	*transaction);